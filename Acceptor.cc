@@ -6,6 +6,7 @@
 #include <sys/socket.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 static int createNonblocking()
 {
@@ -23,10 +24,12 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
     : loop_(loop)
     , acceptSocket_(createNonblocking()) // create listen-socket
     , acceptChannel_(loop_, acceptSocket_.fd())
+    , acceptBatchSize_(kDefaultAcceptBatchSize)
+    , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
     , listenning_(false)
 {
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr); // bind
     /*====================================================================*/
     /**
@@ -42,6 +45,7 @@ Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    ::close(idleFd_);
 }
 
 /*===========================*/
@@ -55,28 +59,76 @@ void Acceptor::listen()
 
 /*============================================*/
 // listenfd有事件发生了，有新用户连接
+// 一次最多accept acceptBatchSize_个连接，LT模式下剩下的连接下一轮poll还会通知
 void Acceptor::handleRead()
 {
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    batch_.clear();
+    for (int i = 0; i < acceptBatchSize_; ++i)
     {
-        if (newConnectionCallback_)
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0)
         {
-            newConnectionCallback_(connfd, peerAddr); // 轮询找到subloop，唤醒，分发当前的channel
+            if (newConnectionBatchCallback_)
+            {
+                batch_.emplace_back(connfd, peerAddr);
+            }
+            else if (newConnectionCallback_)
+            {
+                newConnectionCallback_(connfd, peerAddr); // 轮询找到subloop，唤醒，分发当前的channel
+            }
+            else
+            {
+                ::close(connfd);
+            }
+            continue;
         }
-        else
+
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
         {
-            ::close(connfd);
+            break; // 全连接队列已经取空
         }
-    }
-    else
-    {
-        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
-        if (errno == EMFILE) // The per-process limit on the number of open file descrptors has been reached. 解决方法：集群/分布式部署
+        else if (savedErrno == EINTR || savedErrno == ECONNABORTED || savedErrno == EPROTO)
+        {
+            continue; // 对端在accept之前就断开了，不影响后面的连接
+        }
+        else if (savedErrno == EMFILE || savedErrno == ENFILE)
         {
+            // The per-process limit on the number of open file descrptors has been reached. 解决方法：集群/分布式部署
             LOG_ERROR("%s:%s:%d socket reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
+            handleFdExhausted();
+            break;
         }
+        else
+        {
+            LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+            break;
+        }
+    }
+
+    if (!batch_.empty())
+    {
+        newConnectionBatchCallback_(batch_);
+    }
+}
+
+/**
+ * fd耗尽时连接一直留在全连接队列里，LT模式下listenfd会一直可读，loop就空转烧满一个核
+ * 释放预留的idleFd_，把这个连接accept下来立刻关掉(客户端会收到FIN)，再把idleFd_占回来
+ */
+void Acceptor::handleFdExhausted()
+{
+    if (idleFd_ < 0)
+    {
+        return;
     }
+    ::close(idleFd_);
+    idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+    if (idleFd_ >= 0)
+    {
+        ::close(idleFd_);
+    }
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
 }
-/*============================================*/
\ No newline at end of file
+/*============================================*/
@@ -3,9 +3,12 @@
 #include "noncopyable.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "InetAddress.h"
+
+#include <vector>
+#include <utility>
 
 class EventLoop;
-class InetAddress;
 
 /**
  * Acceptor of incoming TCP connections.
@@ -14,21 +17,36 @@ class Acceptor : noncopyable
 {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
+    using AcceptedConnection = std::pair<int, InetAddress>; // (connfd, peerAddr)
+    using NewConnectionBatchCallback = std::function<void(const std::vector<AcceptedConnection>&)>;
 
     Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport);
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback& cb) 
         { newConnectionCallback_ = std::move(cb); }
+    // 设置了批量回调后，一次可读事件里accept到的所有连接只回调一次
+    void setNewConnectionBatchCallback(const NewConnectionBatchCallback& cb)
+        { newConnectionBatchCallback_ = std::move(cb); }
+    // 每次listenfd可读时最多accept多少个连接，避免一直accept饿死同一个loop上的其他channel
+    void setAcceptBatchSize(int n) { acceptBatchSize_ = n > 0 ? n : 1; }
 
     bool listenning() const { return listenning_; }
+    Socket& acceptSocket() { return acceptSocket_; }
     void listen();
 private:
     void handleRead();
+    void handleFdExhausted();
+
+    static const int kDefaultAcceptBatchSize = 64;
 
     EventLoop* loop_; // Accptor用的就是用户定义的那个baseloop，也成为mainLoop
     Socket acceptSocket_;
     Channel acceptChannel_; // clientfd conn success!!!
     NewConnectionCallback newConnectionCallback_; // 将acceptSocket打包成channel、channel传递给subloop
+    NewConnectionBatchCallback newConnectionBatchCallback_;
+    std::vector<AcceptedConnection> batch_; // 复用，避免每次可读事件都分配
+    int acceptBatchSize_;
+    int idleFd_; // 预留的/dev/null fd，fd耗尽(EMFILE)时用它腾出一个位置把连接accept下来再关掉
     bool listenning_;
 };
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "AsyncLogging.h"
+#include "LogFile.h"
+
+#include <stdio.h>
+#include <chrono>
+
+AsyncLogging::AsyncLogging(const std::string& basename,
+                           off_t rollSize,
+                           int flushInterval,
+                           size_t maxPendingBuffers)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , maxPendingBuffers_(maxPendingBuffers)
+    , running_(false)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "AsyncLogging")
+    , currentBuffer_(new LogBuffer)
+    , nextBuffer_(new LogBuffer)
+    , droppedLines_(0)
+{
+    buffers_.reserve(maxPendingBuffers_);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void AsyncLogging::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+        cond_.notify_one();
+    }
+    thread_.join();
+}
+
+void AsyncLogging::append(const char* logline, size_t len)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (currentBuffer_->avail() > len)
+    {
+        currentBuffer_->append(logline, len); // 绝大多数情况：只是一次memcpy
+        return;
+    }
+
+    // 后台线程跟不上，待写的缓冲区已经到上限了，丢弃这一行，保证内存有界
+    if (buffers_.size() >= maxPendingBuffers_)
+    {
+        droppedLines_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffers_.push_back(std::move(currentBuffer_));
+    if (nextBuffer_)
+    {
+        currentBuffer_ = std::move(nextBuffer_);
+    }
+    else
+    {
+        currentBuffer_.reset(new LogBuffer); // 很少发生
+    }
+    currentBuffer_->append(logline, len);
+    cond_.notify_one();
+}
+
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, flushInterval_);
+    // 后台线程自己也准备两块缓冲区，和前端交换，临界区内只有指针交换
+    BufferPtr newBuffer1(new LogBuffer);
+    BufferPtr newBuffer2(new LogBuffer);
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(maxPendingBuffers_);
+    uint64_t reportedDrops = 0;
+
+    while (true)
+    {
+        bool running = true;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (buffers_.empty() && running_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            running = running_;
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if (!nextBuffer_)
+            {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+        }
+
+        uint64_t drops = droppedLines();
+        if (drops != reportedDrops)
+        {
+            char buf[128];
+            int n = snprintf(buf, sizeof buf, "AsyncLogging dropped %lu log lines (total %lu)\n",
+                             static_cast<unsigned long>(drops - reportedDrops),
+                             static_cast<unsigned long>(drops));
+            output.append(buf, n);
+            reportedDrops = drops;
+        }
+
+        for (const BufferPtr& buffer : buffersToWrite)
+        {
+            output.append(buffer->data(), buffer->length());
+        }
+
+        // 只留两块缓冲区给下一轮用，其余的释放
+        if (buffersToWrite.size() > 2)
+        {
+            buffersToWrite.resize(2);
+        }
+        if (!newBuffer1)
+        {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+        if (!newBuffer2)
+        {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+        buffersToWrite.clear();
+        output.flush();
+
+        if (!running)
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string.h>
+#include <sys/types.h>
+
+/**
+ * 异步日志后端(双缓冲)
+ * 前端线程(各个EventLoop)调用append，只是把日志行拷贝进预先分配好的大缓冲区，不做任何IO；
+ * 缓冲区写满(或者每隔flushInterval秒)就交给后台线程，由后台线程批量写入滚动的日志文件
+ *
+ * 内存有上限：待写的缓冲区超过maxPendingBuffers个(磁盘跟不上)时新日志直接丢弃，
+ * 丢弃的行数可以通过droppedLines()查看，后台线程也会在日志文件里记录一行丢弃提示
+ *
+ * 用法：
+ *   AsyncLogging g_asyncLog("/var/log/server", 500 * 1024 * 1024);
+ *   void asyncOutput(const char* msg, size_t len) { g_asyncLog.append(msg, len); }
+ *   g_asyncLog.start();
+ *   Logger::setOutput(asyncOutput);
+ */
+class AsyncLogging : noncopyable
+{
+public:
+    AsyncLogging(const std::string& basename,
+                 off_t rollSize,
+                 int flushInterval = 3,
+                 size_t maxPendingBuffers = 16);
+    ~AsyncLogging();
+
+    // 线程安全，任意线程都可以调用
+    void append(const char* logline, size_t len);
+
+    void start();
+    void stop(); // 把已经append的日志全部写入文件后返回
+
+    uint64_t droppedLines() const { return droppedLines_.load(std::memory_order_relaxed); }
+
+private:
+    static const size_t kBufferSize = 4 * 1024 * 1024;
+
+    // 定长的日志缓冲区，只做追加
+    class LogBuffer : noncopyable
+    {
+    public:
+        LogBuffer() : cur_(data_) {}
+
+        size_t avail() const { return static_cast<size_t>(data_ + sizeof data_ - cur_); }
+        size_t length() const { return static_cast<size_t>(cur_ - data_); }
+        const char* data() const { return data_; }
+
+        void append(const char* buf, size_t len)
+        {
+            memcpy(cur_, buf, len);
+            cur_ += len;
+        }
+        void reset() { cur_ = data_; }
+
+    private:
+        char data_[kBufferSize];
+        char* cur_;
+    };
+
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    void threadFunc(); // 后台写日志的线程
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    const size_t maxPendingBuffers_;
+
+    std::atomic_bool running_;
+    Thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    BufferPtr currentBuffer_; // 前端正在写的缓冲区
+    BufferPtr nextBuffer_;    // 预备的缓冲区，currentBuffer_写满时直接换上，不用分配内存
+    BufferVector buffers_;    // 写满了等待后台线程写文件的缓冲区
+
+    std::atomic<uint64_t> droppedLines_;
+};
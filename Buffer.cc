@@ -19,6 +19,9 @@
 
 const size_t Buffer::kCheapPrepend;
 const size_t Buffer::kInitialSize;
+const size_t Buffer::kMaxGrowthStep;
+const size_t Buffer::kShrinkRatio;
+const size_t Buffer::kShrinkThreshold;
 
 
 /**
@@ -28,7 +31,40 @@ const size_t Buffer::kInitialSize;
  */
 ssize_t Buffer::readFd(int fd, int* saveErrno)
 {
-    char extrabuf[65536] = {0}; // memory space on the stack
+    // 没有存储的Buffer直接读进loop的scratch块，处理完以后由releaseMemory决定要不要分配自己的存储
+    if (capacity_ == 0)
+    {
+        SlabAllocator* slab = SlabAllocator::current();
+        char* scratch = slab ? slab->acquireScratch() : nullptr;
+        if (scratch)
+        {
+            buffer_ = scratch;
+            capacity_ = SlabAllocator::kScratchSize;
+            borrowed_ = true;
+            readerIndex_ = kCheapPrepend;
+            writerIndex_ = kCheapPrepend;
+
+            const ssize_t n = ::read(fd, beginWrite(), writableBytes());
+            if (n > 0)
+            {
+                writerIndex_ += n;
+            }
+            else
+            {
+                if (n < 0)
+                {
+                    *saveErrno = errno;
+                }
+                releaseMemory();
+            }
+            return n;
+        }
+        // 拿不到scratch(不在loop线程里，或者scratch已经借出去了)：先分配自己的存储，
+        // 下面的readv要用到buffer_和writableBytes()，没有存储时它们都不成立
+        moveToOwnStorage(kInitialSize);
+    }
+
+    char extrabuf[65536]; // memory space on the stack，只有readv写进去的部分会被读取，不需要清零
     struct iovec vec[2];
 
     const size_t writable = writableBytes(); // The remaining writable space of the underlying buffer
@@ -51,7 +87,7 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
     }
     else //extrabuf have data
     {
-        writerIndex_ = buffer_.size();
+        writerIndex_ = capacity_;
         append(extrabuf, n - writable); // writerIndex_ begin to write (n - writable)data
     }
 
@@ -66,4 +102,60 @@ ssize_t Buffer::writeFd(int fd, int* saveErrno)
         *saveErrno = errno;
     }
     return n;
-}
\ No newline at end of file
+}
+
+void Buffer::releaseMemory()
+{
+    size_t needed = kCheapPrepend + readableBytes();
+    if (readableBytes() == 0 || borrowed_
+        || (capacity_ > kShrinkThreshold && capacity_ / kShrinkRatio > needed))
+    {
+        shrink(0);
+    }
+}
+
+void Buffer::shrink(size_t reserve)
+{
+    if (readableBytes() == 0 && reserve == 0)
+    {
+        freeStorage();
+        capacity_ = 0;
+        buffer_ = nullptr;
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = kCheapPrepend;
+    }
+    else if (borrowed_ || SlabAllocator::goodSize(kCheapPrepend + readableBytes() + reserve) < capacity_)
+    {
+        moveToOwnStorage(reserve);
+    }
+}
+
+void Buffer::moveToOwnStorage(size_t len)
+{
+    size_t readable = readableBytes();
+    size_t capacity = SlabAllocator::goodSize(kCheapPrepend + readable + len);
+    char* buffer = static_cast<char*>(SlabAllocator::allocate(capacity));
+    if (readable > 0)
+    {
+        memcpy(buffer + kCheapPrepend, begin() + readerIndex_, readable);
+    }
+    freeStorage();
+    buffer_ = buffer;
+    capacity_ = capacity;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend + readable;
+}
+
+void Buffer::freeStorage()
+{
+    if (borrowed_)
+    {
+        // 借用只发生在loop线程里，并且在同一轮处理中归还，这时当前线程的分配器就是借出scratch的那个
+        SlabAllocator::current()->releaseScratch(buffer_);
+        borrowed_ = false;
+    }
+    else
+    {
+        SlabAllocator::deallocate(buffer_, capacity_);
+    }
+}
@@ -1,8 +1,13 @@
 #pragma once
 
-#include <vector>
+#include "SlabAllocator.h"
+
 #include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <endian.h>
 #include <string>
+#include <algorithm>
 
 /// +-------------------+------------------+------------------+
 /// | prependable bytes |  readable bytes  |  writable bytes  |
@@ -12,28 +17,131 @@
 /// 0      <=      readerIndex   <=   writerIndex    <=     size
 
 // The buffer type definition at the bottom of the network library
+// 存储从当前线程EventLoop的SlabAllocator分配，不做清零；容量按分配器的大小等级向上取整
 class Buffer
 {
 public:
     static const size_t kCheapPrepend = 8;
     static const size_t kInitialSize = 1024;
+    static const size_t kMaxGrowthStep = 4 * 1024 * 1024; // 扩容时按2倍增长，但每次最多多分配这么多
+    static const size_t kShrinkRatio = 4; // releaseMemory: 容量超过实际需要的这么多倍时缩小
+    // releaseMemory: 还有数据时只有容量超过这个值(突发)才缩小，比一次回调能读到的数据(ET预算256KB)大，
+    // 常态下留着半个消息的连接不会每次读都缩小、再扩容
+    static const size_t kShrinkThreshold = 1024 * 1024;
 
+    // initialSize为0时不分配存储，readFd先借用loop的scratch块，用不完的数据才搬到自己的存储
     explicit Buffer(size_t initialSize = kInitialSize)
-        : buffer_(kCheapPrepend + initialSize)
+        : capacity_(initialSize == 0 ? 0 : SlabAllocator::goodSize(kCheapPrepend + initialSize))
+        , buffer_(capacity_ == 0 ? nullptr : static_cast<char*>(SlabAllocator::allocate(capacity_)))
         , readerIndex_(kCheapPrepend)
         , writerIndex_(kCheapPrepend)
+        , borrowed_(false)
     {
         assert(readableBytes() == 0);
-        assert(writableBytes() == initialSize);
+        assert(writableBytes() >= initialSize);
         assert(prependableBytes() == kCheapPrepend);
     }
 
+    ~Buffer()
+    {
+        freeStorage();
+    }
+
+    // 只拷贝可读的数据
+    Buffer(const Buffer& rhs)
+        : capacity_(SlabAllocator::goodSize(kCheapPrepend + rhs.readableBytes()))
+        , buffer_(static_cast<char*>(SlabAllocator::allocate(capacity_)))
+        , readerIndex_(kCheapPrepend)
+        , writerIndex_(kCheapPrepend + rhs.readableBytes())
+        , borrowed_(false)
+    {
+        memcpy(buffer_ + kCheapPrepend, rhs.peek(), rhs.readableBytes());
+    }
+
+    // 直接拿走rhs的存储，rhs变成没有存储(容量为0)的空Buffer，之后写入时再分配
+    // rhs借用着scratch块时先把数据搬到它自己的存储
+    Buffer(Buffer&& rhs)
+        : capacity_(0)
+        , buffer_(nullptr)
+        , readerIndex_(kCheapPrepend)
+        , writerIndex_(kCheapPrepend)
+        , borrowed_(false)
+    {
+        swap(rhs);
+    }
+
+    Buffer& operator=(Buffer rhs) // copy-and-swap，同时用作拷贝赋值和移动赋值
+    {
+        swap(rhs);
+        return *this;
+    }
+
+    void swap(Buffer& rhs)
+    {
+        // scratch块属于loop，不能跟着Buffer换出去
+        if (borrowed_)
+        {
+            moveToOwnStorage(0);
+        }
+        if (rhs.borrowed_)
+        {
+            rhs.moveToOwnStorage(0);
+        }
+        std::swap(capacity_, rhs.capacity_);
+        std::swap(buffer_, rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
+    /**
+     * 处理完一次读到的数据以后调用(TcpConnection在messageCallback_之后调用)
+     * 借用scratch块时把剩下的数据搬到自己的存储并归还scratch；没有剩下的数据时连自己的存储也释放
+     * 一次突发把容量撑大(超过kShrinkThreshold)以后，剩下的数据远小于容量(kShrinkRatio倍)时缩小到刚好放下
+     * 之后空闲的Buffer不占内存，也不会一直挂着突发时的大块存储
+     */
+    void releaseMemory();
+    // 只保留可读数据和reserve字节的可写空间，多余的存储还回去；没有数据并且reserve为0时释放全部存储
+    void shrink(size_t reserve);
+    bool borrowed() const { return borrowed_; }
+    size_t capacity() const { return capacity_; }
+
     size_t readableBytes() const { return writerIndex_ - readerIndex_; }
-    size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+    size_t writableBytes() const { return capacity_ > writerIndex_ ? capacity_ - writerIndex_ : 0; } // 没有存储时为0
     size_t prependableBytes() const { return readerIndex_; }
 
     // Returns the starting address of the readable data in the buffer
     const char* peek() const { return begin() + readerIndex_;} 
+
+    /**
+     * 在可读数据中查找"\r\n"/"\n"，返回指向它的指针，没找到返回nullptr
+     * 用memchr找(glibc里是SIMD实现)，不会逐字节比较
+     */
+    const char* findCRLF() const { return findCRLF(peek()); }
+    const char* findCRLF(const char* start) const
+    {
+        assert(peek() <= start && start <= beginWrite());
+        const char* end = beginWrite();
+        while (start < end)
+        {
+            const char* cr = static_cast<const char*>(memchr(start, '\r', end - start));
+            if (cr == nullptr || cr + 1 == end)
+            {
+                return nullptr;
+            }
+            if (cr[1] == '\n')
+            {
+                return cr;
+            }
+            start = cr + 1;
+        }
+        return nullptr;
+    }
+    const char* findEOL() const { return findEOL(peek()); }
+    const char* findEOL(const char* start) const
+    {
+        assert(peek() <= start && start <= beginWrite());
+        return static_cast<const char*>(memchr(start, '\n', beginWrite() - start));
+    }
     
     // onMessage  Buffer  ->   string 
     void retrieve(size_t len) 
@@ -48,6 +156,16 @@ public:
             retrieveAll();
         }
     }
+    // 读走到end(不含)为止的数据，end一般是findCRLF/findEOL的返回值
+    void retrieveUntil(const char* end)
+    {
+        assert(peek() <= end && end <= beginWrite());
+        retrieve(end - peek());
+    }
+    void retrieveInt64() { retrieve(sizeof(int64_t)); }
+    void retrieveInt32() { retrieve(sizeof(int32_t)); }
+    void retrieveInt16() { retrieve(sizeof(int16_t)); }
+    void retrieveInt8() { retrieve(sizeof(int8_t)); }
     void retrieveAll() 
     {
         readerIndex_ = kCheapPrepend;
@@ -83,6 +201,67 @@ public:
         std::copy(data, data+len, beginWrite()); // data -> buffer
         writerIndex_ += len;
     }
+    void append(const void* data, size_t len) { append(static_cast<const char*>(data), len); }
+
+    /**
+     * 整数读写，缓冲区里都是网络字节序(大端)，接口上是主机字节序
+     * peekInt*: 只看不读走  readInt*: 读出并retrieve  appendInt*: 追加到末尾  prependInt*: 写到可读数据前面
+     */
+    void appendInt64(int64_t x) { uint64_t be = htobe64(static_cast<uint64_t>(x)); append(&be, sizeof be); }
+    void appendInt32(int32_t x) { uint32_t be = htobe32(static_cast<uint32_t>(x)); append(&be, sizeof be); }
+    void appendInt16(int16_t x) { uint16_t be = htobe16(static_cast<uint16_t>(x)); append(&be, sizeof be); }
+    void appendInt8(int8_t x) { append(&x, sizeof x); }
+
+    int64_t peekInt64() const
+    {
+        assert(readableBytes() >= sizeof(int64_t));
+        uint64_t be;
+        memcpy(&be, peek(), sizeof be);
+        return static_cast<int64_t>(be64toh(be));
+    }
+    int32_t peekInt32() const
+    {
+        assert(readableBytes() >= sizeof(int32_t));
+        uint32_t be;
+        memcpy(&be, peek(), sizeof be);
+        return static_cast<int32_t>(be32toh(be));
+    }
+    int16_t peekInt16() const
+    {
+        assert(readableBytes() >= sizeof(int16_t));
+        uint16_t be;
+        memcpy(&be, peek(), sizeof be);
+        return static_cast<int16_t>(be16toh(be));
+    }
+    int8_t peekInt8() const
+    {
+        assert(readableBytes() >= sizeof(int8_t));
+        return static_cast<int8_t>(*peek());
+    }
+
+    int64_t readInt64() { int64_t x = peekInt64(); retrieveInt64(); return x; }
+    int32_t readInt32() { int32_t x = peekInt32(); retrieveInt32(); return x; }
+    int16_t readInt16() { int16_t x = peekInt16(); retrieveInt16(); return x; }
+    int8_t readInt8() { int8_t x = peekInt8(); retrieveInt8(); return x; }
+
+    /**
+     * 把data写到可读数据的前面，使用readerIndex_前面的空间(至少有kCheapPrepend字节)
+     * 典型用法: 先append消息体，再prependInt32(长度)，长度头不需要再拷贝一遍消息体
+     */
+    void prepend(const void* data, size_t len)
+    {
+        if (buffer_ == nullptr)
+        {
+            moveToOwnStorage(0); // 没有存储时readerIndex_前面的空间不存在
+        }
+        assert(len <= prependableBytes());
+        readerIndex_ -= len;
+        memcpy(begin() + readerIndex_, data, len);
+    }
+    void prependInt64(int64_t x) { uint64_t be = htobe64(static_cast<uint64_t>(x)); prepend(&be, sizeof be); }
+    void prependInt32(int32_t x) { uint32_t be = htobe32(static_cast<uint32_t>(x)); prepend(&be, sizeof be); }
+    void prependInt16(int16_t x) { uint16_t be = htobe16(static_cast<uint16_t>(x)); prepend(&be, sizeof be); }
+    void prependInt8(int8_t x) { prepend(&x, sizeof x); }
 
     // Read data directly into buffer 从fd上读取数据
     ssize_t readFd(int fd, int* saveErrno);
@@ -90,8 +269,8 @@ public:
     ssize_t writeFd(int fd, int* saveErrno);
 
 private:
-    char* begin() { return &*buffer_.begin(); }  // The address of the first element of the underlying vector array
-    const char* begin() const { return &*buffer_.begin(); }
+    char* begin() { return buffer_; }  // The address of the first byte of the underlying storage
+    const char* begin() const { return buffer_; }
 
     /*
         --> prependableBytes() = kCheapPrepend + white
@@ -102,13 +281,18 @@ private:
     */
     void makeSpace(size_t len)
     {
-       if (writableBytes() + prependableBytes() < len + kCheapPrepend)
+       if (borrowed_ || writableBytes() + prependableBytes() < len + kCheapPrepend)
        {
-            // FIXME: move readable data
-            buffer_.resize(writerIndex_ + len); // think carefully!!!
+            // 换一块更大的存储(借用scratch时换成自己的存储)，只搬可读的数据
+            // 按2倍增长，连续append时重新分配、搬移的总量是线性的；增长量有上限，大块突发不会多占一倍内存
+            size_t readable = readableBytes();
+            size_t needed = kCheapPrepend + readable + len;
+            size_t grown = capacity_ + std::min(capacity_, kMaxGrowthStep);
+            moveToOwnStorage(std::max(needed, grown) - kCheapPrepend - readable);
        }
        else
        {
+            // 前面retrieve空出来的空间加上可写空间已经够了，先把可读数据挪到前面，不扩容
             // move readable data to the front, make space inside buffer
             assert(kCheapPrepend < readerIndex_);
             size_t readable = readableBytes();
@@ -121,7 +305,13 @@ private:
        }
     }
 
-    std::vector<char> buffer_;
+    // 可读数据搬到新分配的、至少还能写len字节的存储里，旧的存储释放或者归还scratch
+    void moveToOwnStorage(size_t len);
+    void freeStorage();
+
+    size_t capacity_; // 必须在buffer_之前初始化
+    char* buffer_;
     size_t readerIndex_;
     size_t writerIndex_;
+    bool borrowed_; // buffer_是loop的scratch块
 };
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "ChainBuffer.h"
+#include "SlabAllocator.h"
+
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+
+const size_t ChainBuffer::kBlockSize;
+
+struct ChainBuffer::Block
+{
+    char data[kBlockSize];
+};
+
+/**
+ * 块从当前线程EventLoop的SlabAllocator分配，块在哪个线程释放就回到哪个线程的池里
+ * Block的大小正好是一个大小等级，池的上限由SlabAllocator::setCapacity控制
+ */
+ChainBuffer::Block* ChainBuffer::allocBlock()
+{
+    return static_cast<Block*>(SlabAllocator::allocate(sizeof(Block)));
+}
+
+void ChainBuffer::freeBlock(Block* block)
+{
+    SlabAllocator::deallocate(block, sizeof(Block));
+}
+
+/*------------------------------------------------------*/
+
+ChainBuffer::ChainBuffer()
+    : readableBytes_(0)
+{}
+
+ChainBuffer::~ChainBuffer()
+{
+    retrieveAll();
+}
+
+void ChainBuffer::append(const char* data, size_t len)
+{
+    readableBytes_ += len;
+
+    // 先填满最后一个块剩余的空间
+    if (!slices_.empty() && slices_.back().block)
+    {
+        Slice& tail = slices_.back();
+        char* end = const_cast<char*>(tail.data) + tail.len;
+        size_t avail = tail.block->data + kBlockSize - end;
+        size_t n = len < avail ? len : avail;
+        memcpy(end, data, n);
+        tail.len += n;
+        data += n;
+        len -= n;
+    }
+
+    while (len > 0)
+    {
+        Block* block = allocBlock();
+        size_t n = len < kBlockSize ? len : kBlockSize;
+        memcpy(block->data, data, n);
+        slices_.push_back(Slice{block->data, n, block, nullptr, -1, 0});
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::appendSlice(const char* data, size_t len, std::shared_ptr<const void> holder)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    readableBytes_ += len;
+    slices_.push_back(Slice{data, len, nullptr, std::move(holder), -1, 0});
+}
+
+void ChainBuffer::appendFile(int fd, off_t offset, size_t len)
+{
+    if (len == 0)
+    {
+        ::close(fd);
+        return;
+    }
+    readableBytes_ += len;
+    slices_.push_back(Slice{nullptr, len, nullptr, nullptr, fd, offset});
+}
+
+void ChainBuffer::popFront()
+{
+    Slice& front = slices_.front();
+    if (front.block)
+    {
+        freeBlock(front.block);
+    }
+    else if (front.isFile())
+    {
+        ::close(front.fd);
+    }
+    slices_.pop_front();
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+    assert(len <= readableBytes_);
+    readableBytes_ -= len;
+    while (len > 0)
+    {
+        Slice& front = slices_.front();
+        if (len < front.len)
+        {
+            if (front.isFile())
+            {
+                front.offset += len;
+            }
+            else
+            {
+                front.data += len;
+            }
+            front.len -= len;
+            break;
+        }
+        len -= front.len;
+        popFront();
+    }
+}
+
+void ChainBuffer::retrieveAll()
+{
+    while (!slices_.empty())
+    {
+        popFront();
+    }
+    readableBytes_ = 0;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int* saveErrno) const
+{
+    if (slices_.empty())
+    {
+        return 0;
+    }
+
+    const Slice& front = slices_.front();
+    if (front.isFile())
+    {
+        // 偏移量由retrieve推进，这里用一份拷贝
+        off_t offset = front.offset;
+        ssize_t n = ::sendfile(fd, front.fd, &offset, front.len);
+        if (n < 0)
+        {
+            *saveErrno = errno;
+        }
+        return n;
+    }
+
+    // 文件分片之前的所有内存分片一次writev发出去
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    for (auto it = slices_.begin(); it != slices_.end() && !it->isFile() && iovcnt < IOV_MAX; ++it)
+    {
+        vec[iovcnt].iov_base = const_cast<char*>(it->data);
+        vec[iovcnt].iov_len = it->len;
+        ++iovcnt;
+    }
+
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::copyOut(char* dst, size_t len, int* saveErrno) const
+{
+    if (slices_.empty())
+    {
+        return 0;
+    }
+
+    const Slice& front = slices_.front();
+    if (front.isFile())
+    {
+        ssize_t n = ::pread(front.fd, dst, std::min(len, front.len), front.offset);
+        if (n < 0)
+        {
+            *saveErrno = errno;
+        }
+        return n;
+    }
+
+    // 文件分片之前的内存分片依次拷贝
+    size_t copied = 0;
+    for (auto it = slices_.begin(); it != slices_.end() && !it->isFile() && copied < len; ++it)
+    {
+        size_t n = std::min(len - copied, it->len);
+        memcpy(dst + copied, it->data, n);
+        copied += n;
+    }
+    return static_cast<ssize_t>(copied);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * TcpConnection的输出缓冲区：由一串分片(slice)组成
+ *
+ *   | slice | slice | slice | ... |
+ *      ^ readable bytes = 所有分片长度之和
+ *
+ * - 拷贝进来的小块数据写进池化的固定大小的块(Block)，块写满了就接一个新块，
+ *   已有的数据永远不会因为扩容被整体memmove/realloc
+ * - 用户的大块数据可以以引用计数分片的形式挂进来(appendSlice)，完全不拷贝
+ * - 文件分片(appendFile)只记录fd/offset/len，发送时用sendfile(2)在内核里直接拷贝，数据不经过用户态
+ * - writeFd用一次writev把最多IOV_MAX个内存分片发出去，遇到文件分片时用sendfile发送
+ * - copyOut把开头的数据拷贝到调用者的缓冲区(io_uring完成模式)
+ */
+class ChainBuffer : noncopyable
+{
+public:
+    static const size_t kBlockSize = 4096;
+
+    ChainBuffer();
+    ~ChainBuffer();
+
+    size_t readableBytes() const { return readableBytes_; }
+    bool empty() const { return readableBytes_ == 0; }
+
+    // 拷贝data到块里
+    void append(const char* data, size_t len);
+    void append(const void* data, size_t len) { append(static_cast<const char*>(data), len); }
+
+    // 不拷贝，data开始的len字节由holder保证在发送完之前一直有效
+    void appendSlice(const char* data, size_t len, std::shared_ptr<const void> holder);
+    void appendSlice(std::shared_ptr<const std::string> str)
+    {
+        const char* data = str->data();
+        size_t len = str->size();
+        appendSlice(data, len, std::move(str));
+    }
+
+    // 文件分片：发送fd从offset开始的len字节，ChainBuffer接管fd，发送完(或者缓冲区销毁)时close
+    void appendFile(int fd, off_t offset, size_t len);
+
+    // 丢弃前len字节(已经发送出去的数据)
+    void retrieve(size_t len);
+    void retrieveAll();
+
+    // 把缓冲区里的数据通过fd发送出去(writev/sendfile)，返回发送的字节数，不会retrieve
+    // 缓冲区非空时返回0说明队首的文件分片已经读到文件末尾(文件在排队期间被截断)
+    ssize_t writeFd(int fd, int* saveErrno) const;
+
+    /**
+     * 从头拷贝最多len字节到dst，返回拷贝的字节数，不会retrieve(给io_uring完成模式的发送缓冲区用)
+     * 内存分片直接memcpy，文件分片在队首时用pread读出来；和writeFd一样，缓冲区非空时返回0说明文件被截断
+     */
+    ssize_t copyOut(char* dst, size_t len, int* saveErrno) const;
+
+private:
+    struct Block;
+
+    struct Slice
+    {
+        const char* data;                   // 文件分片为nullptr
+        size_t len;
+        Block* block;                       // 数据在池化的块里时不为空，分片负责归还这个块
+        std::shared_ptr<const void> holder; // 引用计数分片，保证用户数据的生命周期
+        int fd;                             // 文件分片的fd，内存分片为-1
+        off_t offset;                       // 文件分片下一个要发送的字节的偏移
+
+        bool isFile() const { return fd >= 0; }
+    };
+
+    static Block* allocBlock();
+    static void freeBlock(Block* block);
+    void popFront();
+
+    std::deque<Slice> slices_;
+    size_t readableBytes_;
+};
@@ -7,6 +7,7 @@
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeEvent = EPOLLET;
 
 Channel::Channel(EventLoop* loop, int fd)
 :   loop_(loop),
@@ -14,6 +15,12 @@ Channel::Channel(EventLoop* loop, int fd)
     events_(0),
     revents_(0),
     index_(-1),
+    registeredEvents_(0),
+    pendingIndex_(-1),
+    completionIo_(false),
+    recvData_(nullptr),
+    recvResult_(0),
+    sendResult_(0),
     tied_(false)
 {}
 
@@ -33,6 +40,7 @@ void Channel::tie(const std::shared_ptr<void>& obj)
 /**
  * 当改变channel所表示fd的events事件后，update负责在poller里更改fd相应的事件epoll_ctl
  * EventLoop => ChannelList(孩子A)  Poller(孩子B)
+ * 实际的epoll_ctl推迟到本轮loop的poll之前，同一轮里的多次修改只会提交最终状态
  */
 void Channel::update()
 {
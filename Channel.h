@@ -49,6 +49,7 @@ public:
 
     int fd() const { return fd_; }
     int events() const { return events_; }
+    int revents() const { return revents_; }
     void set_revents(int revt) { revents_ = revt; } // 便于通过EventLoop设置revents
 
     // 设置fd相应的事件状态
@@ -56,16 +57,47 @@ public:
     void disableReading() { events_ &= ~kReadEvent; update(); }
     void enableWriting() { events_ |= kWriteEvent; update(); }
     void disableWriting() { events_ &= ~kWriteEvent; update(); }
-    void disableAll() { events_ = kNoneEvent; update(); }
+    void disableAll() { events_ &= kEdgeEvent; update(); }
+
+    /**
+     * 边沿触发(EPOLLET)，默认是水平触发
+     * 只修改标志位，在下一次enableReading/enableWriting等调用update时才会注册到poller
+     * 使用ET的一方必须每次都读/写到EAGAIN，否则在下一个边沿到来之前不会再收到通知
+     */
+    void setEdgeTriggered(bool on) { if (on) events_ |= kEdgeEvent; else events_ &= ~kEdgeEvent; }
+    bool isEdgeTriggered() const { return events_ & kEdgeEvent; }
+
+    /**
+     * 完成模式(io_uring，见UringPoller)：poller不通知就绪，而是直接替channel提交recv/send
+     * recv完成时回调readCallback_(数据在recvData()，结果在recvResult())，send完成时回调writeCallback_(结果在sendResult())
+     * 结果和errno一样用负数表示错误；recvData()只在本轮事件处理期间有效
+     */
+    void setCompletionIo(bool on) { completionIo_ = on; }
+    bool isCompletionIo() const { return completionIo_; }
+    const char* recvData() const { return recvData_; }
+    int recvResult() const { return recvResult_; }
+    int sendResult() const { return sendResult_; }
+    void set_recvResult(const char* data, int res) { recvData_ = data; recvResult_ = res; }
+    void set_sendResult(int res) { sendResult_ = res; }
 
     // 返回fd当前的事件状态
-    bool isNoneEvent() const { return events_ == kNoneEvent; }
+    bool isNoneEvent() const { return (events_ & ~kEdgeEvent) == kNoneEvent; }
     bool isWriting() const { return events_ & kWriteEvent; }
     bool isReading() const { return events_ & kReadEvent; }
 
     int index() { return index_; }
     void set_index(int idx) { index_ = idx; }
 
+    // 内核(epoll)里当前登记的事件，由Poller在真正调用epoll_ctl时维护，和events_相同时不需要再更新
+    int registeredEvents() const { return registeredEvents_; }
+    void set_registeredEvents(int revt) { registeredEvents_ = revt; }
+
+    // 已经在EventLoop的待提交列表里，等下一次poll之前统一交给Poller
+    // pendingIndex是在待提交列表里的下标(不在列表里时为-1)，removeChannel用它O(1)删除
+    bool updatePending() const { return pendingIndex_ >= 0; }
+    int pendingIndex() const { return pendingIndex_; }
+    void set_pendingIndex(int idx) { pendingIndex_ = idx; }
+
     // one loop per thread
     EventLoop* ownerLoop() { return loop_; }
 
@@ -77,6 +109,7 @@ private:
     static const int kNoneEvent;
     static const int kReadEvent;
     static const int kWriteEvent;
+    static const int kEdgeEvent;
 
     /*-------------------------------------*/
     EventLoop* loop_; // 事件循环
@@ -84,6 +117,12 @@ private:
     int events_;      // 注册fd感兴趣的事件
     int revents_;     // poller返回的具体发生的事件
     int index_;       // used by Poller
+    int registeredEvents_; // 内核中实际登记的事件
+    int pendingIndex_;     // used by EventLoop
+    bool completionIo_;
+    const char* recvData_;
+    int recvResult_;
+    int sendResult_;
 
     std::weak_ptr<void> tie_;
     bool tied_;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+class Channel;
+
+/**
+ * Poller中 fd => Channel* 的映射
+ * fd是内核从小往上分配的稠密整数，直接用fd做下标的数组代替unordered_map：
+ * 查找不需要哈希，连接建立/断开时也没有节点的分配和释放
+ * 数组按2倍扩容，fd关闭后会被复用，稳定以后不再分配内存
+ * channel在poller中的状态(kNew/kAdded/kDeleted或者PollPoller的下标)仍然记在Channel::index
+ */
+class ChannelMap
+{
+public:
+    ChannelMap() : size_(0) {}
+
+    // fd没有对应的channel时返回nullptr
+    Channel* find(int fd) const
+    {
+        return static_cast<size_t>(fd) < channels_.size() ? channels_[fd] : nullptr;
+    }
+
+    void insert(int fd, Channel* channel)
+    {
+        if (static_cast<size_t>(fd) >= channels_.size())
+        {
+            size_t n = channels_.empty() ? kInitSize : channels_.size();
+            while (n <= static_cast<size_t>(fd))
+            {
+                n *= 2;
+            }
+            channels_.resize(n, nullptr);
+        }
+        if (channels_[fd] == nullptr)
+        {
+            ++size_;
+        }
+        channels_[fd] = channel;
+    }
+
+    void erase(int fd)
+    {
+        if (static_cast<size_t>(fd) < channels_.size() && channels_[fd] != nullptr)
+        {
+            channels_[fd] = nullptr;
+            --size_;
+        }
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    static const size_t kInitSize = 64;
+
+    std::vector<Channel*> channels_; // 下标是fd
+    size_t size_;                    // 非空的项数
+};
@@ -1,5 +1,8 @@
 #include "Poller.h"
 #include "EPollPoller.h"
+#include "PollPoller.h"
+#include "UringPoller.h"
+#include "Logger.h"
 
 #include <stdlib.h>
 
@@ -7,7 +10,19 @@ Poller* Poller::newDefaultPoller(EventLoop* loop)
 {
     if (::getenv("MUDUO_USE_POLL"))
     {
-        return nullptr; // 生成poll的实例
+        return new PollPoller(loop); // 生成poll的实例
+    }
+    else if (::getenv("MUDUO_USE_URING"))
+    {
+        // 生成io_uring的实例，内核不支持(或者被seccomp禁用)时退回epoll
+        UringPoller* poller = new UringPoller(loop);
+        if (poller->valid())
+        {
+            return poller;
+        }
+        delete poller;
+        LOG_ERROR("io_uring unavailable, fall back to epoll \n");
+        return new EPollPoller(loop);
     }
     else
     {
@@ -27,7 +27,10 @@ public:
 
 private:
     static const int kInitEventListSize = 16;
+    static const int kShrinkWindow = 1024; // 每kShrinkWindow次poll检查一次是否缩小events_
 
+    // 根据最近一次poll返回的事件数调整events_的大小
+    void adjustEventList(int numEvents);
     // 填写活跃的连接
     void fillActiveChannels(int numEvents, ChannelList* activeChannels) const;
     // 更新channel通道
@@ -35,7 +38,7 @@ private:
 
     /**
      * @Poller抽象类中继承来了关于channel的map集合
-     * typedef std::unordered_map<int, Channel*>;
+     * fd为下标的数组，见ChannelMap.h
      * ChannelMap channels_;
      */
 
@@ -43,4 +46,6 @@ private:
 
     int epollfd_;
     EventList events_;
+    int pollsInWindow_;     // 本窗口内poll的次数
+    int maxEventsInWindow_; // 本窗口内单次poll返回的最多事件数
 };
\ No newline at end of file
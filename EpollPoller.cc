@@ -7,6 +7,7 @@
 #include <unistd.h>
 #include <assert.h>
 #include <string.h>
+#include <algorithm>
 
 // channel的成员index_ = -1 
 const int kNew = -1;    // channel未添加到poller中
@@ -16,7 +17,9 @@ const int kDeleted = 2; // channel从poller中删除
 EPollPoller::EPollPoller(EventLoop* loop) : 
     Poller(loop),
     epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
-    events_(kInitEventListSize)  // vector<epoll_event>
+    events_(kInitEventListSize),  // vector<epoll_event>
+    pollsInWindow_(0),
+    maxEventsInWindow_(0)
 {
     if (epollfd_ < 0)
     {
@@ -39,6 +42,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
     // 实际上应该用LOG_DEBUG输出日志更为合理
     LOG_INFO("func[%s] => fd total count: %lu \n", __FUNCTION__, implicit_cast<size_t>(channels_.size()));
 
+    countSyscall();
     int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
     int saveError = errno;
     Timestamp now(Timestamp::now());
@@ -47,10 +51,6 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
     {
         LOG_INFO("%d events happened \n", numEvents);
         fillActiveChannels(numEvents, activeChannels);
-        if (implicit_cast<size_t>(numEvents) == events_.size())
-        {
-            events_.resize(events_.size() * 2);
-        }
     }
     else if (numEvents == 0)
     {
@@ -64,9 +64,38 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
             LOG_ERROR("EpollPoller::poll() err!");
         }
     }
+    adjustEventList(numEvents);
     return now;
 }
 
+/**
+ * 填满了就翻倍，下一次epoll_wait可以取回更多事件
+ * 连续kShrinkWindow次poll的最大事件数都不到容量的1/4就减半，突发流量过去以后把内存还回去
+ */
+void EPollPoller::adjustEventList(int numEvents)
+{
+    if (implicit_cast<size_t>(numEvents) == events_.size())
+    {
+        events_.resize(events_.size() * 2);
+        pollsInWindow_ = 0;
+        maxEventsInWindow_ = 0;
+        return;
+    }
+
+    maxEventsInWindow_ = std::max(maxEventsInWindow_, numEvents);
+    if (++pollsInWindow_ < kShrinkWindow)
+    {
+        return;
+    }
+    if (events_.size() > static_cast<size_t>(kInitEventListSize)
+        && implicit_cast<size_t>(maxEventsInWindow_) < events_.size() / 4)
+    {
+        EventList(events_.size() / 2).swap(events_);
+    }
+    pollsInWindow_ = 0;
+    maxEventsInWindow_ = 0;
+}
+
 // channel update remove => EventLoop updateChannel removeChannel => Poller
 /**
  *              EventLoop
@@ -78,19 +107,25 @@ void EPollPoller::updateChannel(Channel* channel)
     const int index = channel->index();
     LOG_INFO("func=%s => fd=%d | events=%d | index =%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
 
+    if ((index == kNew || index == kDeleted) && channel->isNoneEvent())
+    {
+        // 没有关注任何事件，也就不需要加到epoll里
+        countUpdateSkipped();
+        return;
+    }
+
     if (index == kNew || index == kDeleted)
     {
         // a new one, add with EPOLL_CTL_ADD
         int fd = channel->fd();
         if (index == kNew)
         {
-            assert(channels_.find(fd) == channels_.end());
-            channels_[fd] = channel;
+            assert(channels_.find(fd) == nullptr);
+            channels_.insert(fd, channel);
         }
         else // index == kDeleted
         {
-            assert(channels_.find(fd) != channels_.end());
-            assert(channels_[fd] == channel);
+            assert(channels_.find(fd) == channel);
         }
 
         channel->set_index(kAdded);
@@ -100,8 +135,7 @@ void EPollPoller::updateChannel(Channel* channel)
     {
         // update existing one with EPOLL_CTL_MOD/DEL
         int fd = channel->fd();
-        assert(channels_.find(fd) != channels_.end());
-        assert(channels_[fd] == channel);
+        assert(channels_.find(fd) == channel);
         assert(index == kAdded);
 
         if (channel->isNoneEvent())
@@ -109,6 +143,11 @@ void EPollPoller::updateChannel(Channel* channel)
             update(EPOLL_CTL_DEL, channel);
             channel->set_index(kDeleted);
         }
+        else if (channel->events() == channel->registeredEvents())
+        {
+            // 同一轮loop里开了又关(比如EPOLLOUT)，最终状态和内核里一样，不用再epoll_ctl
+            countUpdateSkipped();
+        }
         else
         {
             update(EPOLL_CTL_MOD, channel);
@@ -122,8 +161,7 @@ void EPollPoller::removeChannel(Channel* channel)
     int fd = channel->fd();
     LOG_INFO("func=%s => fd=%d \n", __FUNCTION__, fd);
 
-    assert(channels_.find(fd) != channels_.end());
-    assert(channels_[fd] == channel);
+    assert(channels_.find(fd) == channel);
     assert(channel->isNoneEvent());
 
     channels_.erase(fd);
@@ -165,6 +203,9 @@ void EPollPoller::update(int operation, Channel* channel)
     ep_event.data.ptr = channel;
     
     
+    countUpdate();
+    countSyscall();
+    channel->set_registeredEvents(operation == EPOLL_CTL_DEL ? 0 : channel->events());
     if (::epoll_ctl(epollfd_, operation, fd, &ep_event) < 0)
     {
         if (operation == EPOLL_CTL_DEL)
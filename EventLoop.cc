@@ -2,12 +2,17 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "TimingWheel.h"
+#include "SlabAllocator.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <error.h>
-#include <mutex>
+#include <sched.h>
+#include <time.h>
+#include <cassert>
 
 // 防止一个线程创建多个EventLoop | __thread 等效于 thread_local 每个线程都有自己的副本
 __thread EventLoop* t_loopInThisThread = nullptr;
@@ -25,18 +30,40 @@ int createEventfd()
     }
     return evtfd;
 }
+
+static int64_t monotonicNs()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
 /*------------------------------------------------------*/
 
 EventLoop::EventLoop()
-    : looping_(false)
+    : slab_(new SlabAllocator)
+    , looping_(false)
     , quit_(false)
     , callingPendingFunctors_(false)
+    , numPendingFunctors_(0)
     , threadId_(CurrentThread::tid())
+    , numUpdatesCoalesced_(0)
     , poller_(Poller::newDefaultPoller(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
+    , wakeupPending_(false)
+    , numWakeups_(0)
+    , numWakeupsSuppressed_(0)
+    , wakeupTimeNs_(0)
+    , spinPollUs_(0)
+    , timerQueue_(new TimerQueue(this))
+    , numConnections_(0)
+    , pendingOutputBytes_(0)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
+    for (auto& bucket : wakeupLatency_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
     if (t_loopInThisThread)
     {
         LOG_FATAL("Another EventLoop %p exists in this thread %d \n", t_loopInThisThread, threadId_);
@@ -44,6 +71,7 @@ EventLoop::EventLoop()
     else
     {
         t_loopInThisThread = this;
+        SlabAllocator::setCurrent(slab_.get());
     }
 
     /*✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳*/
@@ -73,6 +101,16 @@ void EventLoop::handleRead()
     {
         LOG_ERROR("EventLoop::handleRead() reads %ld bytes instead of 8 \n", n);
     }
+    int64_t latency = monotonicNs() - wakeupTimeNs_.load(std::memory_order_relaxed);
+    int bucket = 0;
+    while (bucket < kLatencyBuckets - 1 && (latency >> (bucket + 1)) > 0)
+    {
+        ++bucket;
+    }
+    wakeupLatency_[bucket].fetch_add(1, std::memory_order_relaxed);
+    // eventfd已经读走，之后的wakeup需要重新写eventfd
+    // 在这之前被省掉的wakeup，它们投递的回调已经入队，会在本轮的doPendingFunctors中执行
+    wakeupPending_.store(false);
 }
 
 /**
@@ -95,9 +133,10 @@ void EventLoop::loop()
     while(!quit_)
     {
         activeChannels_.clear();
+        flushChannelUpdates();
         /*✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳*/
         // 监听两类fd  一种clientfd，一种wakeupfd
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_); // subloop在wait
+        pollReturnTime_ = pollWithSpin(); // subloop在wait
         /*✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳*/
         for (Channel* channel : activeChannels_)
         {
@@ -151,17 +190,16 @@ void EventLoop::runInLoop(Functor cb)
 // 把cb放入队列中，唤醒loop所在的线程，执行cb
 /**
  * 由于mainloop、subloop之间可以互相调用其中的runinloop|queueinloop
- * 所以是并发访问，需要添加锁 
- * 传进去的cb可能不止一个，故需要vector<Functor> pendingFunctors_;存储loop需要执行的所有回调操作
+ * 所以是并发访问，pendingFunctors_是无锁的MPSC队列，生产者之间不会互相等待
+ * 传进去的cb可能不止一个，故需要队列存储loop需要执行的所有回调操作
  */
 void EventLoop::queueInLoop(Functor cb)
 {
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(std::move(cb));
-    }
+    pendingFunctors_.push(std::move(cb));
 
-    // 唤醒相应的，需要执行上面回调的loop线程了
+    numPendingFunctors_.fetch_add(1);
+
+    // 唤醒相应的，需要执行上面回调的loop线程了(一批连续的投递只会写一次eventfd，见wakeup)
     // || callingPendingFunctors_ 的意思是：当前loop正在执行回调，但是loop又有了新的回调，势必又进入while阻塞，故wakeup唤醒
     if (!isInLoopThread() || callingPendingFunctors_)
     {
@@ -172,6 +210,15 @@ void EventLoop::queueInLoop(Functor cb)
 // 唤醒loop所在线程,向wakeupfd_写数据,wakeupChannel就发生读事件,当前loop线程就会被唤醒
 void EventLoop::wakeup()
 {
+    // loop还没有处理上一次唤醒(eventfd还可读)，它一定会再经过handleRead和doPendingFunctors，不用再写
+    if (wakeupPending_.exchange(true))
+    {
+        numWakeupsSuppressed_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    numWakeups_.fetch_add(1, std::memory_order_relaxed);
+    wakeupTimeNs_.store(monotonicNs(), std::memory_order_relaxed);
+
     uint64_t one = 1;
     ssize_t n = ::write(wakeupFd_, &one, sizeof one);
     if (n != sizeof one)
@@ -180,36 +227,173 @@ void EventLoop::wakeup()
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
+TimingWheel* EventLoop::timingWheel()
+{
+    if (!timingWheel_)
+    {
+        timingWheel_.reset(new TimingWheel(this));
+    }
+    return timingWheel_.get();
+}
+
 void EventLoop::updateChannel(Channel* channel)
 {
-    poller_->updateChannel(channel);
+    if (channel->updatePending())
+    {
+        numUpdatesCoalesced_.store(numUpdatesCoalesced_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    channel->set_pendingIndex(static_cast<int>(pendingUpdates_.size()));
+    pendingUpdates_.push_back(channel);
 }
 
+// channel马上要析构或者fd马上要关闭，不能等到下一轮，待提交的修改直接丢弃
+// 和列表最后一个交换后pop_back，一轮里大量连接关闭时也是O(1)(各channel的提交顺序无关紧要)
 void EventLoop::removeChannel(Channel* channel)
 {
-    poller_->removeChannel(channel);
+    if (channel->updatePending())
+    {
+        int idx = channel->pendingIndex();
+        assert(pendingUpdates_[idx] == channel);
+        Channel* last = pendingUpdates_.back();
+        pendingUpdates_[idx] = last;
+        last->set_pendingIndex(idx);
+        pendingUpdates_.pop_back();
+        channel->set_pendingIndex(-1);
+    }
+    if (poller_->hasChannel(channel)) // 从来没有提交过的channel不在poller里
+    {
+        poller_->removeChannel(channel);
+    }
 }
 
 bool EventLoop::hasChannel(Channel* channel)
 { 
-    return poller_->hasChannel(channel);
+    return channel->updatePending() || poller_->hasChannel(channel);
+}
+
+void EventLoop::flushChannelUpdates()
+{
+    for (Channel* channel : pendingUpdates_)
+    {
+        channel->set_pendingIndex(-1);
+        poller_->updateChannel(channel);
+    }
+    pendingUpdates_.clear();
+}
+
+/**
+ * 忙轮询阶段用0超时poll，不会因为进入睡眠、再被调度回来而增加唤醒延迟
+ * 超过spinPollUs_还没有事件就退回阻塞的poll，空闲的loop不会一直占着CPU
+ */
+Timestamp EventLoop::pollWithSpin()
+{
+    int spinUs = spinPollUs_.load(std::memory_order_relaxed);
+    if (spinUs > 0)
+    {
+        int64_t deadline = monotonicNs() + static_cast<int64_t>(spinUs) * 1000;
+        do
+        {
+            Timestamp now = poller_->poll(0, &activeChannels_);
+            if (!activeChannels_.empty() || quit_)
+            {
+                return now;
+            }
+        } while (monotonicNs() < deadline);
+    }
+    return poller_->poll(kPollTimeMs, &activeChannels_);
+}
+
+std::vector<uint64_t> EventLoop::wakeupLatencyHistogram() const
+{
+    std::vector<uint64_t> histogram(kLatencyBuckets);
+    for (int i = 0; i < kLatencyBuckets; ++i)
+    {
+        histogram[i] = wakeupLatency_[i].load(std::memory_order_relaxed);
+    }
+    return histogram;
+}
+
+uint64_t EventLoop::numPollerUpdates() const
+{
+    return poller_->numUpdates();
+}
+
+uint64_t EventLoop::numPollerSyscalls() const
+{
+    return poller_->numSyscalls();
+}
+
+bool EventLoop::supportsEdgeTriggered() const
+{
+    return poller_->supportsEdgeTriggered();
+}
+
+bool EventLoop::supportsCompletionIo() const
+{
+    return poller_->supportsCompletionIo();
+}
+
+char* EventLoop::completionSendBuffer(Channel* channel, size_t* size)
+{
+    return poller_->sendBuffer(channel, size);
+}
+
+void EventLoop::submitCompletionSend(Channel* channel, size_t len)
+{
+    poller_->submitSend(channel, len);
+}
+
+uint64_t EventLoop::numPollerUpdatesAvoided() const
+{
+    return numUpdatesCoalesced_.load(std::memory_order_relaxed) + poller_->numUpdatesSkipped();
 }
 
 /*✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳*/
 void EventLoop::doPendingFunctors() // 执行回调
 {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
 
+    // 只执行进入时已经投递的回调，执行期间新投递的回调留到下一轮，避免一直有生产者时loop饿死其他channel
+    const size_t n = numPendingFunctors_.load();
+    Functor functor;
+    for (size_t i = 0; i < n; ++i)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);
+        // 计数在入队之后才增加，所以这n个回调一定已经入队，只是生产者可能还没链接完成，让出CPU等一下
+        while (!pendingFunctors_.pop(&functor))
+        {
+            sched_yield();
+        }
+        functor(); // 执行当前loop需要执行的回调操作
     }
+    callingPendingFunctors_ = false;
 
-    for (const Functor& functor : functors)
+    // 执行期间新投递的回调由它们的生产者负责wakeup，下一轮poll会立即返回
+    if (n > 0)
     {
-        functor(); // 执行当前loop需要执行的回调操作
+        numPendingFunctors_.fetch_sub(n);
     }
-    callingPendingFunctors_ = false;
 }
 /*✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳✳*/
\ No newline at end of file
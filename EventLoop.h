@@ -3,15 +3,20 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "MpscQueue.h"
 
 #include <functional>
 #include <vector>
 #include <atomic>
 #include <memory>
-#include <mutex>
 
 class Channel;
 class Poller;
+class TimerQueue;
+class TimingWheel;
+class SlabAllocator;
 
 
 // Reactor, at most one per thread.
@@ -35,28 +40,93 @@ public:
     void runInLoop(Functor cb); // 在当前loop中执行cb
     void queueInLoop(Functor cb); // 把cb放入队列中，唤醒loop所在的线程，执行cb
 
-    void wakeup(); // 用来唤醒loop所在的线程
+    void wakeup(); // 用来唤醒loop所在的线程，已经有一次唤醒还没被loop处理时不会重复写eventfd
+
+    // 唤醒统计：实际写eventfd的次数 / 因为已有唤醒未处理而省掉的次数
+    uint64_t numWakeups() const { return numWakeups_.load(std::memory_order_relaxed); }
+    uint64_t numWakeupsSuppressed() const { return numWakeupsSuppressed_.load(std::memory_order_relaxed); }
+
+    /**
+     * 唤醒延迟直方图：从wakeup()写eventfd到loop处理这次唤醒(handleRead)经过的时间
+     * 第i个桶统计[2^i, 2^(i+1))纳秒，第0个桶还包括0，最后一个桶包括更大的值
+     * 任意线程都可以读，用来调整setSpinPollUs
+     */
+    static const int kLatencyBuckets = 32;
+    std::vector<uint64_t> wakeupLatencyHistogram() const;
+
+    /**
+     * 忙轮询：每次处理完事件后，先以0超时poll最多us微秒，期间没有事件才阻塞在poller上
+     * 用一个CPU核换取更低的唤醒延迟，0表示关闭(默认)，任意线程都可以设置
+     */
+    void setSpinPollUs(int us) { spinPollUs_.store(us, std::memory_order_relaxed); }
+    int spinPollUs() const { return spinPollUs_.load(std::memory_order_relaxed); }
+
+    /**
+     * 负载统计，任意线程都可以读，给EventLoopThreadPool的负载均衡策略用
+     * 连接数由TcpServer在分配/移除连接时维护，待发送字节数由TcpConnection在输出缓冲变化时维护
+     */
+    int numConnections() const { return numConnections_.load(std::memory_order_relaxed); }
+    void addConnections(int delta) { numConnections_.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t pendingOutputBytes() const { return pendingOutputBytes_.load(std::memory_order_relaxed); }
+    void addPendingOutputBytes(int64_t delta) { pendingOutputBytes_.fetch_add(delta, std::memory_order_relaxed); }
+    size_t queueDepth() const { return numPendingFunctors_.load(std::memory_order_relaxed); }
+
+    /**
+     * 定时任务，线程安全，可以在其他线程调用
+     * 回调总是在loop所在的线程执行
+     */
+    TimerId runAt(Timestamp time, TimerCallback cb); // 在time时刻执行cb
+    TimerId runAfter(double delay, TimerCallback cb); // delay秒后执行cb
+    TimerId runEvery(double interval, TimerCallback cb); // 每隔interval秒执行一次cb
+    void cancel(TimerId timerId); // 取消定时器
+
+    // 本loop的时间轮(精度1秒)，第一次调用时创建，给连接空闲超时这类海量、频繁重置的超时使用
+    // 只能在loop所在的线程调用
+    TimingWheel* timingWheel();
 
     // EventLoop的方法 =》 Poller的方法
-    void updateChannel(Channel* channel); 
-    void removeChannel(Channel* channel);
+    void updateChannel(Channel* channel); // 只记录下来，下一次poll之前统一提交
+    void removeChannel(Channel* channel); // 立即生效
     bool hasChannel(Channel* channel);
 
+    // 向内核提交关注事件修改的次数 / 合并或者和内核状态相同而省掉的次数
+    uint64_t numPollerUpdates() const;
+    uint64_t numPollerUpdatesAvoided() const;
+    uint64_t numPollerSyscalls() const;
+    // poller是否支持边沿触发
+    bool supportsEdgeTriggered() const;
+    // poller是否支持完成模式的收发(io_uring)，以及完成模式的发送接口(见Poller.h)
+    bool supportsCompletionIo() const;
+    char* completionSendBuffer(Channel* channel, size_t* size);
+    void submitCompletionSend(Channel* channel, size_t len);
+
+    // 本loop的小块内存池，Buffer/TcpConnection等从这里分配(见SlabAllocator.h)，统计可以在任意线程读
+    SlabAllocator* slabAllocator() const { return slab_.get(); }
+
     // 判断EventLoop对象是否在自己的线程里面
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
 private:
     void handleRead();  // waked up
     void doPendingFunctors(); // 执行回调
+    void flushChannelUpdates(); // 把本轮积攒的channel修改交给poller
+    Timestamp pollWithSpin(); // 按spinPollUs_先忙轮询再阻塞
 
     using ChannelList = std::vector<Channel*>;
 
+    // 第一个构造、最后一个析构，其他成员析构时释放的内存还能回到池里
+    std::unique_ptr<SlabAllocator> slab_;
+
     std::atomic_bool looping_; // 原子操作，通过CAS实现
     std::atomic_bool quit_; //标志退出loop循环
 
     const pid_t threadId_; // 记录当前loop所在线程id
 
     Timestamp pollReturnTime_; // poller返回发生事件的channel的时间点
+    // 本轮loop里修改过关注事件、还没提交给poller的channel
+    // 必须在poller_和各个持有channel的成员之前声明，它们析构时还会调用removeChannel
+    ChannelList pendingUpdates_;
+    std::atomic<uint64_t> numUpdatesCoalesced_; // 已经在pendingUpdates_里，再次修改被合并的次数
     std::unique_ptr<Poller> poller_;
 
     /**
@@ -66,10 +136,22 @@ private:
      */
     int wakeupFd_; 
     std::unique_ptr<Channel> wakeupChannel_;
+    std::atomic_bool wakeupPending_; // 已经写过eventfd但loop还没有读走，此时再wakeup是多余的
+    std::atomic<uint64_t> numWakeups_;
+    std::atomic<uint64_t> numWakeupsSuppressed_;
+    std::atomic<int64_t> wakeupTimeNs_; // 最近一次真正写eventfd的时间(CLOCK_MONOTONIC)
+    std::atomic<uint64_t> wakeupLatency_[kLatencyBuckets];
+    std::atomic<int> spinPollUs_;
+
+    std::unique_ptr<TimerQueue> timerQueue_; // timerfd也注册在poller_上，必须在poller_之后构造
+    std::unique_ptr<TimingWheel> timingWheel_; // 由timerQueue_驱动，必须在timerQueue_之前析构
 
     ChannelList activeChannels_;
 
     std::atomic_bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_; // 存储loop需要执行的所有回调操作
-    std::mutex mutex_; // 互斥锁，保护上面vector容器的线程安全操作
+    MpscQueue<Functor> pendingFunctors_; // 存储loop需要执行的所有回调操作，无锁队列，多个线程同时投递不会互相阻塞
+    std::atomic<size_t> numPendingFunctors_; // 已经投递但还没执行的回调数量
+
+    std::atomic<int> numConnections_;
+    std::atomic<int64_t> pendingOutputBytes_;
 };
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "EventLoopThread.h"
 #include "EventLoop.h"
+#include "Logger.h"
+
+#include <pthread.h>
+#include <sched.h>
 
 /**
  * 解析使用绑定器bind: 因为事实上 EventLoopThread::threadFunc 和 name 这两个参数是传递到 类Thread中的
@@ -13,7 +17,9 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,
         thread_(std::bind(&EventLoopThread::threadFunc, this), name),   
         mutex_(),
         cond_(),
-        callback_(cb)
+        callback_(cb),
+        schedPolicy_(-1),
+        schedPriority_(0)
 {}
 
 EventLoopThread::~EventLoopThread()
@@ -51,6 +57,8 @@ EventLoop* EventLoopThread::startLoop()
 // 下面这个方法，是在单独的新线程里面运行的
 void EventLoopThread::threadFunc()
 {
+    applyPlacement(); // 必须在创建loop之前
+
     EventLoop loop; // 创建一个独立的eventloop，和上面的线程是一一对应的，one loop per thread
  
     if (callback_) // 如果有需要传递的回调，就可以运行
@@ -68,4 +76,36 @@ void EventLoopThread::threadFunc()
 
     std::unique_lock<std::mutex> lock(mutex_);
     loop_ = nullptr;
-}
\ No newline at end of file
+}
+// 在新线程里运行：绑核、设置调度策略，失败只记录日志，loop照常运行
+void EventLoopThread::applyPlacement()
+{
+    if (!cpus_.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus_)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+        if (ret != 0)
+        {
+            LOG_ERROR("EventLoopThread %s setaffinity err:%d \n", thread_.name().c_str(), ret);
+        }
+    }
+
+    if (schedPolicy_ >= 0)
+    {
+        struct sched_param param;
+        param.sched_priority = schedPriority_;
+        int ret = ::pthread_setschedparam(::pthread_self(), schedPolicy_, &param);
+        if (ret != 0)
+        {
+            LOG_ERROR("EventLoopThread %s setschedparam err:%d \n", thread_.name().c_str(), ret);
+        }
+    }
+}
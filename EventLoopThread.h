@@ -4,6 +4,7 @@
 #include <functional>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 
 class EventLoop;
 
@@ -17,8 +18,19 @@ public:
     ~EventLoopThread();
     EventLoop* startLoop();
 
+    /**
+     * 以下设置必须在startLoop()之前调用，在新线程里、EventLoop构造之前生效
+     * 这样loop以及它的poller、定时器、缓冲区等内存都是在绑定的CPU上第一次访问的，
+     * 按Linux默认的first-touch策略会分配在该CPU所在的NUMA节点上
+     */
+    // 把线程绑定到cpus里的CPU上(可以是一个CPU，也可以是一个NUMA节点的整组CPU)
+    void setCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+    // 调度策略SCHED_OTHER/SCHED_FIFO/SCHED_RR等，实时策略需要CAP_SYS_NICE
+    void setSchedPolicy(int policy, int priority) { schedPolicy_ = policy; schedPriority_ = priority; }
+
 private:
     void threadFunc(); // 被Thread调用的回调函数
+    void applyPlacement();
 
     EventLoop* loop_;
     bool exiting_;
@@ -26,4 +38,7 @@ private:
     std::mutex mutex_;
     std::condition_variable cond_;
     ThreadInitCallback callback_;
+    std::vector<int> cpus_;
+    int schedPolicy_; // -1表示不修改
+    int schedPriority_;
 };
\ No newline at end of file
@@ -10,6 +10,9 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const std::string&
     , started_(false)
     , numThreads_(0)
     , next_(0)
+    , pinPerThread_(true)
+    , schedPolicy_(-1)
+    , schedPriority_(0)
 {}
 
 EventLoopThreadPool::~EventLoopThreadPool() 
@@ -28,6 +31,14 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
 
         /*******************************************************/
         EventLoopThread* t = new EventLoopThread(cb, buf);
+        if (!cpus_.empty())
+        {
+            t->setCpuAffinity(pinPerThread_ ? std::vector<int>(1, cpus_[i % cpus_.size()]) : cpus_);
+        }
+        if (schedPolicy_ >= 0)
+        {
+            t->setSchedPolicy(schedPolicy_, schedPriority_);
+        }
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop()); // 底层创建线程，绑定一个新的EventLoop,并返回该loop的地址
         /*******************************************************/
@@ -58,6 +69,19 @@ EventLoop* EventLoopThreadPool::getNextLoop()
     return loop;
 }
 
+EventLoop* EventLoopThreadPool::selectLoop(const InetAddress& peerAddr)
+{
+    if (loops_.empty())
+    {
+        return baseLoop_;
+    }
+    if (!balancer_)
+    {
+        return getNextLoop();
+    }
+    return balancer_->select(loops_, peerAddr);
+}
+
 EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
 {
     EventLoop* loop = baseLoop_;
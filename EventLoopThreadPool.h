@@ -1,5 +1,6 @@
 #pragma once 
 #include "noncopyable.h"
+#include "LoadBalancer.h"
 
 #include <string>
 #include <vector>
@@ -8,6 +9,7 @@
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : noncopyable
 {
@@ -19,6 +21,15 @@ public:
 
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
 
+    /**
+     * loop线程的放置，必须在start()之前设置
+     * perThread为true时第i个线程绑定到cpus[i % cpus.size()]这一个CPU上；
+     * 为false时所有线程都绑定到整个cpus集合(例如一个NUMA节点的全部CPU)，由调度器在集合内调度
+     */
+    void setCpuAffinity(const std::vector<int>& cpus, bool perThread = true)
+    { cpus_ = cpus; pinPerThread_ = perThread; }
+    void setSchedPolicy(int policy, int priority) { schedPolicy_ = policy; schedPriority_ = priority; }
+
     // 开始工作
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
@@ -26,6 +37,11 @@ public:
     EventLoop* getNextLoop();
     EventLoop* getLoopForHash(size_t hashCode);
 
+    // 按负载均衡策略给新连接选择loop，没有设置策略时等同于getNextLoop()
+    EventLoop* selectLoop(const InetAddress& peerAddr);
+    // 接管balancer的所有权，只能在分配连接的线程调用
+    void setLoadBalancer(LoadBalancer* balancer) { balancer_.reset(balancer); }
+
     std::vector<EventLoop*> getAllLoops();
 
     bool started() const { return started_; }
@@ -39,4 +55,9 @@ private:
     int next_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
+    std::unique_ptr<LoadBalancer> balancer_;
+    std::vector<int> cpus_;
+    bool pinPerThread_;
+    int schedPolicy_;
+    int schedPriority_;
 };
\ No newline at end of file
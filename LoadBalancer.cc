@@ -0,0 +1,141 @@
+#include "LoadBalancer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+
+// 负载相同时从上次的位置往后找，避免连接全部堆在下标小的loop上
+class RotatingBalancer : public LoadBalancer
+{
+protected:
+    template <typename Less>
+    EventLoop* selectMin(const std::vector<EventLoop*>& loops, Less less)
+    {
+        size_t n = loops.size();
+        size_t start = next_++ % n;
+        EventLoop* best = loops[start];
+        for (size_t i = 1; i < n; ++i)
+        {
+            EventLoop* loop = loops[(start + i) % n];
+            if (less(loop, best))
+            {
+                best = loop;
+            }
+        }
+        return best;
+    }
+
+    size_t next_ = 0;
+};
+
+class RoundRobinBalancer : public RotatingBalancer
+{
+public:
+    EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress&) override
+    {
+        return loops[next_++ % loops.size()];
+    }
+};
+
+class LeastConnectionsBalancer : public RotatingBalancer
+{
+public:
+    EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress&) override
+    {
+        return selectMin(loops, [](EventLoop* a, EventLoop* b) {
+            return a->numConnections() < b->numConnections();
+        });
+    }
+};
+
+class LeastPendingBalancer : public RotatingBalancer
+{
+public:
+    EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress&) override
+    {
+        return selectMin(loops, [](EventLoop* a, EventLoop* b) {
+            int64_t pa = a->pendingOutputBytes();
+            int64_t pb = b->pendingOutputBytes();
+            if (pa != pb)
+            {
+                return pa < pb;
+            }
+            return a->queueDepth() < b->queueDepth();
+        });
+    }
+};
+
+/**
+ * 每个loop在环上放kVirtualNodes个虚拟节点，对端ip哈希后顺时针找第一个节点
+ * loop数量变化时只有约1/n的客户端会换loop
+ */
+class ConsistentHashBalancer : public LoadBalancer
+{
+public:
+    EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress& peerAddr) override
+    {
+        if (loops != loops_)
+        {
+            buildRing(loops);
+        }
+        uint64_t h = mix(peerAddr.getSockAddr()->sin_addr.s_addr);
+        auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(h, static_cast<size_t>(0)));
+        if (it == ring_.end())
+        {
+            it = ring_.begin();
+        }
+        return loops_[it->second];
+    }
+
+private:
+    static const int kVirtualNodes = 160;
+
+    // splitmix64的finalizer，把相邻的ip/下标打散到整个64位空间
+    static uint64_t mix(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    void buildRing(const std::vector<EventLoop*>& loops)
+    {
+        loops_ = loops;
+        ring_.clear();
+        ring_.reserve(loops.size() * kVirtualNodes);
+        for (size_t i = 0; i < loops.size(); ++i)
+        {
+            for (int v = 0; v < kVirtualNodes; ++v)
+            {
+                ring_.emplace_back(mix((static_cast<uint64_t>(i) << 32) | static_cast<uint64_t>(v)), i);
+            }
+        }
+        std::sort(ring_.begin(), ring_.end());
+    }
+
+    std::vector<EventLoop*> loops_;
+    std::vector<std::pair<uint64_t, size_t>> ring_; // (hash, loops_下标)，按hash排序
+};
+
+} // namespace
+
+LoadBalancer* LoadBalancer::newLoadBalancer(Policy policy)
+{
+    switch (policy)
+    {
+    case kLeastConnections:
+        return new LeastConnectionsBalancer;
+    case kLeastPending:
+        return new LeastPendingBalancer;
+    case kConsistentHash:
+        return new ConsistentHashBalancer;
+    case kRoundRobin:
+    default:
+        return new RoundRobinBalancer;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <vector>
+
+class EventLoop;
+class InetAddress;
+
+/**
+ * 新连接分配给哪个subloop的策略，EventLoopThreadPool::selectLoop调用
+ * 只在分配连接的线程(baseloop)里使用，实现不需要考虑线程安全
+ * 读取的负载统计(EventLoop::numConnections等)是其他线程维护的近似值
+ */
+class LoadBalancer : noncopyable
+{
+public:
+    enum Policy
+    {
+        kRoundRobin,        // 轮询
+        kLeastConnections,  // 当前连接数最少的loop
+        kLeastPending,      // 待发送字节数最少的loop，相同时比较任务队列长度
+        kConsistentHash,    // 按对端ip做一致性哈希，同一个客户端总是落在同一个loop
+    };
+
+    virtual ~LoadBalancer() = default;
+
+    // loops非空
+    virtual EventLoop* select(const std::vector<EventLoop*>& loops, const InetAddress& peerAddr) = 0;
+
+    // 获得对应策略的实现[在LoadBalancer.cc中实现]
+    static LoadBalancer* newLoadBalancer(Policy policy);
+};
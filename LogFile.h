@@ -0,0 +1,40 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <string>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+/**
+ * 滚动日志文件，只给AsyncLogging的后台线程使用(不是线程安全的)
+ * 文件名: basename.20221017-101530.hostname.pid.log
+ * 写满rollSize字节或者跨天时切换到新文件
+ */
+class LogFile : noncopyable
+{
+public:
+    LogFile(const std::string& basename, off_t rollSize, int flushInterval = 3);
+    ~LogFile();
+
+    void append(const char* logline, size_t len);
+    void flush();
+    bool rollFile();
+
+private:
+    static std::string getLogFileName(const std::string& basename, time_t* now);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_; // 最多隔多少秒fflush一次
+
+    FILE* fp_;
+    off_t writtenBytes_;
+    time_t startOfPeriod_; // 当前文件所在的那一天的0点(UTC)
+    time_t lastRoll_;
+    time_t lastFlush_;
+    char buffer_[64 * 1024]; // 文件的用户态缓冲区
+
+    static const int kRollPerSeconds = 60 * 60 * 24;
+};
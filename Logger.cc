@@ -1,40 +1,104 @@
 #include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "Logger.h"
 #include "Timestamp.h"
 
+static void defaultOutput(const char* msg, size_t len)
+{
+    ::fwrite(msg, 1, len, stdout);
+}
+
+static void defaultFlush()
+{
+    ::fflush(stdout);
+}
+
+static Logger::OutputFunc g_output = defaultOutput;
+static Logger::FlushFunc g_flush = defaultFlush;
+static std::atomic<bool> g_useCoarseClock(false);
+
+static int initLogLevel()
+{
+    const char* level = ::getenv("MUDUO_LOG_LEVEL");
+    if (level)
+    {
+        if (::strcmp(level, "DEBUG") == 0) return DEBUG;
+        if (::strcmp(level, "INFO") == 0) return INFO;
+        if (::strcmp(level, "ERROR") == 0) return ERROR;
+        if (::strcmp(level, "FATAL") == 0) return FATAL;
+    }
+    return INFO;
+}
+
+std::atomic<int> g_logLevel(initLogLevel());
+
 Logger& Logger::instance()
 {
     static Logger logger;
     return logger;
 }
 
-void Logger::setLogLevel(int level)
+void Logger::setOutput(OutputFunc out)
 {
-    logLevel_ = level;
+    g_output = out;
 }
 
-// 写日志 【级别信息】 time : msg
-void Logger::log(std::string msg)
+void Logger::setFlush(FlushFunc flush)
 {
-    switch (logLevel_)
+    g_flush = flush;
+}
+
+void Logger::setUseCoarseClock(bool on)
+{
+    g_useCoarseClock.store(on, std::memory_order_relaxed);
+}
+
+// 写日志 【级别信息】 time file:line : msg
+void Logger::log(int level, const char* file, int line, const char* msg)
+{
+    const char* levelName = "";
+    switch (level)
     {
     case INFO:
-        std::cout << "[INFO]";
+        levelName = "[INFO]";
         break;
     case ERROR:
-        std::cout << "[ERROR]";
+        levelName = "[ERROR]";
         break;
     case FATAL:
-        std::cout << "[FATAL]";
+        levelName = "[FATAL]";
         break;
     case DEBUG:
-        std::cout << "[DEBUG]";
+        levelName = "[DEBUG]";
         break;
     default:
         break;
     }
 
-    // 打印时间和msg
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
-}
\ No newline at end of file
+    const char* slash = ::strrchr(file, '/');
+    const char* basename = slash ? slash + 1 : file;
+
+    // 打印时间和msg，整行格式化好以后一次交给output，异步日志后端只需要一次拷贝
+    // 时间戳直接格式化到栈上，同一秒内的日志只重新渲染微秒部分
+    Timestamp now = g_useCoarseClock.load(std::memory_order_relaxed) ? Timestamp::nowCoarse() : Timestamp::now();
+    char time[32];
+    now.formatTo(time, sizeof time, true);
+
+    char buf[1200];
+    int n = snprintf(buf, sizeof buf, "%s%s %s:%d : %s\n",
+                     levelName, time, basename, line, msg);
+    if (n < 0)
+    {
+        return;
+    }
+    size_t len = static_cast<size_t>(n) < sizeof buf ? static_cast<size_t>(n) : sizeof buf - 1;
+    g_output(buf, len);
+
+    if (level == FATAL)
+    {
+        g_flush(); // 马上要exit了，把缓冲的日志刷出去
+    }
+}
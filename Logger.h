@@ -2,40 +2,45 @@
 
 #include <string>
 #include <iostream>
+#include <atomic>
 
 #include "noncopyable.h"
 
 #define LOG(x) (std::cout << __LINE__ << " : " <<  __PRETTY_FUNCTION__ <<  " : " << (x) << std::endl)
 
-// LOG_INFO("%s %d", arg1, arg2)
+/**
+ * LOG_INFO("%s %d", arg1, arg2)
+ * 先检查全局的日志阈值，级别不够时直接跳过，snprintf格式化和参数求值都不会发生，
+ * 关掉的级别只花一次可预测的分支
+ */
 #define LOG_INFO(LogmsgFormat, ...) \
     do \
     { \
-        Logger& logger = Logger::instance(); \
-        logger.setLogLevel(INFO); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        if (Logger::logLevel() <= INFO) \
+        { \
+            char buf[1024]; \
+            snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
+            Logger::instance().log(INFO, __FILE__, __LINE__, buf); \
+        } \
     } while(0) 
 
 #define LOG_ERROR(LogmsgFormat, ...) \
     do \
     { \
-        Logger& logger = Logger::instance(); \
-        logger.setLogLevel(ERROR); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        if (Logger::logLevel() <= ERROR) \
+        { \
+            char buf[1024]; \
+            snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
+            Logger::instance().log(ERROR, __FILE__, __LINE__, buf); \
+        } \
     } while(0) 
 
 #define LOG_FATAL(LogmsgFormat, ...) \
     do \
     { \
-        Logger& logger = Logger::instance(); \
-        logger.setLogLevel(FATAL); \
-        char buf[1024] = {0}; \
+        char buf[1024]; \
         snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        Logger::instance().log(FATAL, __FILE__, __LINE__, buf); \
         exit(-1); \
     } while(0) 
 
@@ -44,37 +49,52 @@
 #define LOG_DEBUG(LogmsgFormat, ...) \
     do \
     { \
-        Logger& logger = Logger::instance(); \
-        logger.setLogLevel(DEBUG); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        if (Logger::logLevel() <= DEBUG) \
+        { \
+            char buf[1024]; \
+            snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__); \
+            Logger::instance().log(DEBUG, __FILE__, __LINE__, buf); \
+        } \
     } while(0) 
 #else   
     #define LOG_DEBUG(LogmsgFormat, ...)
 #endif
 
-// 定义日志的级别 INFO ERROR FATAL DEBUG 
+// 定义日志的级别，按严重程度从低到高排列，低于全局阈值的日志不输出
 enum LogLevel
 {
+    DEBUG,  // 调试信息
     INFO,   // 普通信息
     ERROR,  // 错误信息
-    FATAL,  // core信息
-    DEBUG   // 调试信息
+    FATAL   // core信息
 };
 
+// 全局日志阈值，默认INFO，启动时可以用环境变量MUDUO_LOG_LEVEL=DEBUG/INFO/ERROR/FATAL设置
+extern std::atomic<int> g_logLevel;
+
 // 输出一个日志类
 class Logger : noncopyable
 {
 public:
+    // 日志的输出目的地，默认写到stdout；可以换成AsyncLogging::append，把IO从loop线程中拿走
+    using OutputFunc = void (*)(const char* msg, size_t len);
+    using FlushFunc = void (*)();
+
     // 获取日志唯一的实例对象
     static Logger& instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+
+    // 设置/获取全局日志阈值，线程安全，运行中随时可以修改，不需要重新编译
+    static void setLogLevel(int level) { g_logLevel.store(level, std::memory_order_relaxed); }
+    static int logLevel() { return g_logLevel.load(std::memory_order_relaxed); }
+
+    // 写日志，级别和调用位置由每次调用传入，单例本身没有可变状态
+    void log(int level, const char* file, int line, const char* msg);
+
+    static void setOutput(OutputFunc out);
+    static void setFlush(FlushFunc flush);
+    // 日志时间戳改用CLOCK_REALTIME_COARSE，省掉每行一次的精确时钟读取，代价是毫秒级的精度
+    static void setUseCoarseClock(bool on);
 private:
-    int logLevel_;
     Logger() {}
 };
 
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <utility>
+
+/**
+ * 无锁的多生产者单消费者队列(Dmitry Vyukov的MPSC node-based queue)
+ * 给EventLoop的pendingFunctors_使用：任意线程push，只有loop所在的线程pop
+ *
+ * push: 一次原子exchange + 一次store，生产者之间不会互相等待
+ * pop:  消费者独占tail_，不需要任何原子RMW操作
+ *
+ * 注意：生产者在exchange和链接next之间被打断时，消费者会暂时看到"空"队列，
+ * 此时pop返回false，但元素并没有丢，生产者链接完成之后就能pop到
+ *
+ * 节点是复用的，稳定运行时push/pop不分配内存：
+ * - 消费者把出队的节点压回队列的空闲栈freeNodes_(CAS入栈)
+ * - 生产者先从本线程的节点缓存里取，缓存空了就用一次exchange把整个空闲栈拿走(整体取走没有ABA问题)，
+ *   空闲栈也空了才new，所以节点总数只和同时在队列里的最大元素个数有关
+ * - 线程缓存里的节点可以用于同类型的任何一个队列，线程退出时释放
+ */
+template <typename T>
+class MpscQueue : noncopyable
+{
+public:
+    MpscQueue()
+        : head_(new Node())
+        , tail_(head_.load(std::memory_order_relaxed))
+        , freeNodes_(nullptr)
+        , numNodesAllocated_(1)
+    {}
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(&value))
+        {
+        }
+        delete tail_; // 哨兵节点
+        deleteNodes(freeNodes_.load(std::memory_order_acquire));
+    }
+
+    // 线程安全，任意线程都可以调用
+    void push(T value)
+    {
+        Node* node = allocNode();
+        node->value = std::move(value);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 只能由消费者线程调用，队列为空(或者生产者还没链接完成)时返回false
+    bool pop(T* value)
+    {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            return false;
+        }
+        *value = std::move(next->value);
+        next->value = T(); // 哨兵节点不再持有元素的资源(比如回调捕获的shared_ptr)
+        tail_ = next;      // next成为新的哨兵节点
+        freeNode(tail);
+        return true;
+    }
+
+    // 一共new过多少个节点(包括哨兵)，稳定运行时不再增长
+    uint64_t numNodesAllocated() const { return numNodesAllocated_.load(std::memory_order_relaxed); }
+
+private:
+    struct Node
+    {
+        Node() : next(nullptr), nextFree(nullptr) {}
+
+        std::atomic<Node*> next;
+        Node* nextFree; // 在空闲栈/线程缓存里时的链接
+        T value;
+    };
+
+    // 每个线程一份的节点缓存
+    struct NodeCache
+    {
+        NodeCache() : head(nullptr) {}
+        ~NodeCache() { deleteNodes(head); }
+
+        Node* head;
+    };
+
+    static void deleteNodes(Node* node)
+    {
+        while (node)
+        {
+            Node* next = node->nextFree;
+            delete node;
+            node = next;
+        }
+    }
+
+    Node* allocNode()
+    {
+        static thread_local NodeCache t_cache;
+        if (t_cache.head == nullptr)
+        {
+            t_cache.head = freeNodes_.exchange(nullptr, std::memory_order_acquire);
+        }
+        Node* node = t_cache.head;
+        if (node == nullptr)
+        {
+            numNodesAllocated_.fetch_add(1, std::memory_order_relaxed);
+            return new Node();
+        }
+        t_cache.head = node->nextFree;
+        node->next.store(nullptr, std::memory_order_relaxed);
+        return node;
+    }
+
+    // 只有消费者调用，生产者对这个节点的最后一次访问(链接next)已经被pop看到，可以安全复用
+    void freeNode(Node* node)
+    {
+        Node* top = freeNodes_.load(std::memory_order_relaxed);
+        do
+        {
+            node->nextFree = top;
+        } while (!freeNodes_.compare_exchange_weak(top, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // 生产者和消费者各自访问的指针放在不同的cache line上，避免false sharing
+    alignas(64) std::atomic<Node*> head_; // 生产者从这里入队
+    alignas(64) Node* tail_;              // 消费者从这里出队
+    alignas(64) std::atomic<Node*> freeNodes_; // 消费者归还、生产者整体取走的空闲节点
+    std::atomic<uint64_t> numNodesAllocated_;
+};
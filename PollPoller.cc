@@ -0,0 +1,129 @@
+#include "PollPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+#include "Types.h"
+
+#include <errno.h>
+#include <assert.h>
+#include <sys/epoll.h>
+
+// channel的成员index_ = -1 表示还不在pollfds_中，否则就是在pollfds_中的下标
+const int kNew = -1;
+
+PollPoller::PollPoller(EventLoop* loop)
+    : Poller(loop)
+{
+}
+
+PollPoller::~PollPoller() = default;
+
+Timestamp PollPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+    LOG_DEBUG("func[%s] => fd total count: %lu \n", __FUNCTION__, implicit_cast<size_t>(channels_.size()));
+
+    countSyscall();
+    int numEvents = ::poll(pollfds_.data(), pollfds_.size(), timeoutMs);
+    int saveError = errno;
+    Timestamp now(Timestamp::now());
+
+    if (numEvents > 0)
+    {
+        LOG_DEBUG("%d events happened \n", numEvents);
+        fillActiveChannels(numEvents, activeChannels);
+    }
+    else if (numEvents == 0)
+    {
+        LOG_DEBUG("%s timeout! \n", __FUNCTION__);
+    }
+    else
+    {
+        if (saveError != EINTR)
+        {
+            errno = saveError;
+            LOG_ERROR("PollPoller::poll() err:%d \n", saveError);
+        }
+    }
+    return now;
+}
+
+// POLLIN/POLLPRI/POLLOUT/POLLRDHUP和对应的EPOLL*数值相同，Channel可以直接使用
+void PollPoller::updateChannel(Channel* channel)
+{
+    const int index = channel->index();
+    const int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d | events=%d | index =%d \n", __FUNCTION__, fd, channel->events(), index);
+
+    const short events = static_cast<short>(channel->events() & ~EPOLLET);
+    if (index == kNew)
+    {
+        if (channel->isNoneEvent())
+        {
+            // 没有关注任何事件，也就不需要加到pollfds_里
+            countUpdateSkipped();
+            return;
+        }
+        assert(channels_.find(fd) == nullptr);
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = events;
+        pfd.revents = 0;
+        pollfds_.push_back(pfd);
+        channel->set_index(static_cast<int>(pollfds_.size()) - 1);
+        channels_.insert(fd, channel);
+    }
+    else
+    {
+        assert(channels_.find(fd) == channel);
+        assert(0 <= index && index < static_cast<int>(pollfds_.size()));
+        struct pollfd& pfd = pollfds_[index];
+        assert(pfd.fd == fd || pfd.fd == -fd - 1);
+        pfd.fd = channel->isNoneEvent() ? -fd - 1 : fd; // 负的fd会被poll忽略
+        pfd.events = events;
+        pfd.revents = 0;
+    }
+    countUpdate();
+}
+
+void PollPoller::removeChannel(Channel* channel)
+{
+    int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d \n", __FUNCTION__, fd);
+
+    assert(channels_.find(fd) == channel);
+    assert(channel->isNoneEvent());
+
+    channels_.erase(fd);
+
+    int index = channel->index();
+    assert(0 <= index && index < static_cast<int>(pollfds_.size()));
+    // EventLoop可能还没把disableAll提交过来，这里不要求fd已经取反
+    if (implicit_cast<size_t>(index) != pollfds_.size() - 1)
+    {
+        // 和末尾的pollfd交换，再修正被移动的那个channel的下标
+        int backFd = pollfds_.back().fd;
+        if (backFd < 0)
+        {
+            backFd = -backFd - 1;
+        }
+        pollfds_[index] = pollfds_.back();
+        channels_.find(backFd)->set_index(index);
+    }
+    pollfds_.pop_back();
+    channel->set_index(kNew);
+}
+
+// 填写活跃的连接，找到numEvents个就提前结束
+void PollPoller::fillActiveChannels(int numEvents, ChannelList* activeChannels) const
+{
+    for (auto pfd = pollfds_.begin(); pfd != pollfds_.end() && numEvents > 0; ++pfd)
+    {
+        if (pfd->revents > 0)
+        {
+            --numEvents;
+            Channel* channel = channels_.find(pfd->fd);
+            assert(channel != nullptr);
+            channel->set_revents(pfd->revents);
+            activeChannels->push_back(channel);
+        }
+    }
+}
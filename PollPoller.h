@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <vector>
+#include <poll.h>
+
+class Channel;
+
+/**
+ * poll使用OOP，fd很少时没有epoll fd，修改关注事件也不需要任何系统调用
+ * pollfds_是紧凑数组，channel的index_就是它在pollfds_中的下标，删除时和末尾交换，O(1)
+ * 不关注任何事件的channel仍然占着位置，fd取反(-fd-1)让poll忽略它
+ *
+ * poll没有边沿触发，supportsEdgeTriggered()返回false，TcpConnection会退回水平触发
+ */
+class PollPoller : public Poller
+{
+public:
+    PollPoller(EventLoop* loop);
+    ~PollPoller() override;
+
+    // 重写基类Poller的抽象方法
+    Timestamp poll(int timeoutMs, ChannelList* activeChannels) override; // poll
+    void updateChannel(Channel* channel) override; // 只修改pollfds_
+    void removeChannel(Channel* channel) override;
+    bool supportsEdgeTriggered() const override { return false; }
+
+private:
+    // 填写活跃的连接
+    void fillActiveChannels(int numEvents, ChannelList* activeChannels) const;
+
+    using PollFdList = std::vector<struct pollfd>;
+    PollFdList pollfds_;
+};
@@ -3,12 +3,14 @@
 
 Poller::Poller(EventLoop* loop)
     : ownerLoop_(loop)
+    , numUpdates_(0)
+    , numUpdatesSkipped_(0)
+    , numSyscalls_(0)
 {}
 
 bool Poller::hasChannel(Channel* channel) const
 {
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    return channels_.find(channel->fd()) == channel;
 } 
 
 /**
@@ -2,9 +2,11 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
+#include "ChannelMap.h"
 
 #include <vector>
-#include <unordered_map>
+#include <atomic>
+#include <stdint.h>
 
 class Channel;
 class EventLoop;
@@ -23,17 +25,42 @@ public:
     virtual void updateChannel(Channel* channel) = 0;
     virtual void removeChannel(Channel* channel) = 0;
 
+    // 是否支持边沿触发(Channel::kEdgeEvent)，poll不支持
+    virtual bool supportsEdgeTriggered() const { return true; }
+
+    /**
+     * 完成模式(Channel::setCompletionIo)，只有UringPoller支持
+     * 发送时先用sendBuffer拿到channel的发送缓冲区(最多*size字节)，填好数据后submitSend提交，
+     * 完成之前同一个channel不能再提交；提交合并到下一次poll的系统调用里
+     */
+    virtual bool supportsCompletionIo() const { return false; }
+    virtual char* sendBuffer(Channel*, size_t* size) { *size = 0; return nullptr; }
+    virtual void submitSend(Channel*, size_t) {}
+
     // 判断参数channel是否在当前Poller当中
     bool hasChannel(Channel* channel) const;
 
+    // 真正修改内核关注事件的次数(epoll_ctl) / 因为和内核已有状态相同而省掉的次数
+    uint64_t numUpdates() const { return numUpdates_.load(std::memory_order_relaxed); }
+    uint64_t numUpdatesSkipped() const { return numUpdatesSkipped_.load(std::memory_order_relaxed); }
+    // poller自己进入内核的次数(epoll_wait + epoll_ctl，或者io_uring_enter)
+    uint64_t numSyscalls() const { return numSyscalls_.load(std::memory_order_relaxed); }
+
     // EventLoop可以通过该接口获得默认的IO复用的具体实现[在Poller.cc中不实现]
     static Poller* newDefaultPoller(EventLoop* loop);
 
 protected:
-    // map的key: sockfd  value: sockfd所属的channel通道类型
-    using ChannelMap = std::unordered_map<int, Channel*>;
+    // 下标: sockfd  值: sockfd所属的channel通道类型
     ChannelMap channels_;
 
+    // 只有loop线程写，其他线程可以读统计
+    void countUpdate() { numUpdates_.store(numUpdates_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+    void countSyscall() { numSyscalls_.store(numSyscalls_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+    void countUpdateSkipped() { numUpdatesSkipped_.store(numUpdatesSkipped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
 private:
     EventLoop* ownerLoop_; // 定义Poller所属的事件循环EventLoop
+    std::atomic<uint64_t> numUpdates_;
+    std::atomic<uint64_t> numUpdatesSkipped_;
+    std::atomic<uint64_t> numSyscalls_;
 };
\ No newline at end of file
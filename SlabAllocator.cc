@@ -0,0 +1,169 @@
+#include "SlabAllocator.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#include <new>
+
+const size_t SlabAllocator::kMinSize;
+const size_t SlabAllocator::kMaxSize;
+const size_t SlabAllocator::kDefaultCapacity;
+const size_t SlabAllocator::kScratchSize;
+
+// 由EventLoop设置，one loop per thread，相当于每个EventLoop一个分配器
+static __thread SlabAllocator* t_slab = nullptr;
+
+SlabAllocator::SlabAllocator()
+    : scratch_(nullptr)
+    , scratchInUse_(false)
+    , capacity_(kDefaultCapacity)
+    , numAllocations_(0)
+    , numReused_(0)
+    , numReleased_(0)
+    , cachedBytes_(0)
+{
+    for (FreeNode*& head : freeLists_)
+    {
+        head = nullptr;
+    }
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    if (t_slab == this)
+    {
+        t_slab = nullptr; // 之后的释放直接free
+    }
+    for (FreeNode*& head : freeLists_)
+    {
+        while (head)
+        {
+            FreeNode* next = head->next;
+            ::free(head);
+            head = next;
+        }
+    }
+    ::free(scratch_);
+}
+
+SlabAllocator* SlabAllocator::current()
+{
+    return t_slab;
+}
+
+void SlabAllocator::setCurrent(SlabAllocator* slab)
+{
+    t_slab = slab;
+}
+
+char* SlabAllocator::acquireScratch()
+{
+    if (scratchInUse_)
+    {
+        return nullptr;
+    }
+    if (scratch_ == nullptr)
+    {
+        scratch_ = static_cast<char*>(::malloc(kScratchSize));
+        if (scratch_ == nullptr)
+        {
+            return nullptr;
+        }
+    }
+    scratchInUse_ = true;
+    return scratch_;
+}
+
+void SlabAllocator::releaseScratch(char* scratch)
+{
+    assert(scratch == scratch_ && scratchInUse_);
+    (void)scratch;
+    scratchInUse_ = false;
+}
+
+// 第i个等级的块大小是kMinSize << i
+int SlabAllocator::sizeClass(size_t size)
+{
+    int cls = 0;
+    size_t classSize = kMinSize;
+    while (classSize < size)
+    {
+        classSize <<= 1;
+        ++cls;
+    }
+    return cls;
+}
+
+size_t SlabAllocator::goodSize(size_t size)
+{
+    if (size > kMaxSize)
+    {
+        return size;
+    }
+    return kMinSize << sizeClass(size);
+}
+
+void* SlabAllocator::allocate(size_t size)
+{
+    SlabAllocator* slab = t_slab;
+    if (slab == nullptr || size > kMaxSize)
+    {
+        // 线程里没有EventLoop时也按大小等级分配：这块内存可能在某个loop线程释放，进入那个等级的空闲链表
+        void* p = ::malloc(goodSize(size));
+        if (p == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+    return slab->alloc(sizeClass(size));
+}
+
+void SlabAllocator::deallocate(void* p, size_t size)
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+    SlabAllocator* slab = t_slab;
+    if (slab == nullptr || size > kMaxSize)
+    {
+        ::free(p);
+        return;
+    }
+    slab->free(p, sizeClass(size));
+}
+
+void* SlabAllocator::alloc(int cls)
+{
+    numAllocations_.store(numAllocations_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    FreeNode* head = freeLists_[cls];
+    if (head)
+    {
+        freeLists_[cls] = head->next;
+        cachedBytes_.store(cachedBytes_.load(std::memory_order_relaxed) - (kMinSize << cls), std::memory_order_relaxed);
+        numReused_.store(numReused_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return head;
+    }
+    void* p = ::malloc(kMinSize << cls);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void SlabAllocator::free(void* p, int cls)
+{
+    size_t size = kMinSize << cls;
+    size_t cached = cachedBytes_.load(std::memory_order_relaxed);
+    if (cached + size > capacity_)
+    {
+        numReleased_.store(numReleased_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        ::free(p);
+        return;
+    }
+    FreeNode* node = static_cast<FreeNode*>(p);
+    node->next = freeLists_[cls];
+    freeLists_[cls] = node;
+    cachedBytes_.store(cached + size, std::memory_order_relaxed);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 每个EventLoop一个的小块内存池：按2的幂分成若干个大小等级，每个等级一个空闲链表
+ * Buffer的存储、ChainBuffer的块、TcpConnection对象(连同shared_ptr的控制块)都从这里分配，
+ * 连接频繁建立/断开时释放的内存直接被下一个连接复用，不再经过malloc/free
+ *
+ * - EventLoop构造时把自己的分配器设置为当前线程的分配器(current())，析构时清掉
+ * - 静态的allocate/deallocate使用当前线程的分配器，线程里没有EventLoop或者超过kMaxSize时直接malloc/free
+ * - 每一块都是单独malloc出来的，在哪个线程释放就回到哪个线程的池里(或者直接free)，跨线程释放是安全的
+ * - 池里缓存的总字节数超过capacity时多余的块直接free
+ * - 统计只有所属线程写，其他线程可以读
+ */
+class SlabAllocator : noncopyable
+{
+public:
+    static const size_t kMinSize = 64;
+    static const size_t kMaxSize = 64 * 1024;
+    static const size_t kDefaultCapacity = 4 * 1024 * 1024;
+    static const size_t kScratchSize = 64 * 1024;
+
+    SlabAllocator();
+    ~SlabAllocator();
+
+    // 当前线程的分配器，没有时为nullptr
+    static SlabAllocator* current();
+    static void setCurrent(SlabAllocator* slab);
+
+    // 实际分配的大小(size向上取整到大小等级)，调用者可以把多出来的部分当作容量使用
+    static size_t goodSize(size_t size);
+    // 在当前线程的分配器上分配/释放，deallocate的size必须和allocate时相同
+    static void* allocate(size_t size);
+    static void deallocate(void* p, size_t size);
+
+    /**
+     * 整个loop共享的一块kScratchSize字节的临时存储，Buffer::readFd在Buffer没有存储时直接读到这里
+     * 同一时间只能借给一个Buffer，已经被借走时返回nullptr
+     */
+    char* acquireScratch();
+    void releaseScratch(char* scratch);
+
+    // 池里最多缓存多少字节
+    void setCapacity(size_t bytes) { capacity_ = bytes; }
+    size_t capacity() const { return capacity_; }
+
+    uint64_t numAllocations() const { return numAllocations_.load(std::memory_order_relaxed); }
+    uint64_t numReused() const { return numReused_.load(std::memory_order_relaxed); } // 复用空闲块，省掉的malloc
+    uint64_t numReleased() const { return numReleased_.load(std::memory_order_relaxed); } // 超过capacity还给系统的块
+    size_t cachedBytes() const { return cachedBytes_.load(std::memory_order_relaxed); }
+
+private:
+    static const int kNumClasses = 11; // 64B ... 64KB
+
+    struct FreeNode
+    {
+        FreeNode* next;
+    };
+
+    static int sizeClass(size_t size);
+    void* alloc(int cls);
+    void free(void* p, int cls);
+
+    FreeNode* freeLists_[kNumClasses];
+    char* scratch_; // 第一次借用时分配
+    bool scratchInUse_;
+    size_t capacity_;
+    std::atomic<uint64_t> numAllocations_;
+    std::atomic<uint64_t> numReused_;
+    std::atomic<uint64_t> numReleased_;
+    std::atomic<size_t> cachedBytes_;
+};
+
+// 给std::allocate_shared等标准库接口使用的分配器，全部转发给SlabAllocator的静态接口
+template <typename T>
+class SlabStlAllocator
+{
+public:
+    using value_type = T;
+
+    SlabStlAllocator() = default;
+    template <typename U>
+    SlabStlAllocator(const SlabStlAllocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(SlabAllocator::allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { SlabAllocator::deallocate(p, n * sizeof(T)); }
+};
+
+template <typename T, typename U>
+bool operator==(const SlabStlAllocator<T>&, const SlabStlAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const SlabStlAllocator<T>&, const SlabStlAllocator<U>&) { return false; }
@@ -10,6 +10,8 @@
 #include <netinet/tcp.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <linux/filter.h>
 
 void setNonBlockAndCloseOnExec(int sockfd)
 {
@@ -122,4 +124,44 @@ void Socket::setKeepAlive(bool on)
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE,
                &optval, static_cast<socklen_t>(sizeof optval));
-}
\ No newline at end of file
+}
+bool Socket::setBusyPoll(int us)
+{
+#ifdef SO_BUSY_POLL
+    int optval = us;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL,
+                     &optval, static_cast<socklen_t>(sizeof optval)) < 0)
+    {
+        LOG_ERROR("SO_BUSY_POLL failed, errno:%d \n", errno);
+        return false;
+    }
+    return true;
+#else
+    LOG_ERROR("SO_BUSY_POLL is not supported.");
+    return false;
+#endif
+}
+
+bool Socket::attachReusePortCpuSteering(int numSockets)
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    // A = cpu; A = A % numSockets; return A
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<__u32>(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<__u32>(numSockets) },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof code / sizeof code[0];
+    prog.filter = code;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) < 0)
+    {
+        LOG_ERROR("SO_ATTACH_REUSEPORT_CBPF failed, errno:%d \n", errno);
+        return false;
+    }
+    return true;
+#else
+    LOG_ERROR("SO_ATTACH_REUSEPORT_CBPF is not supported.");
+    return false;
+#endif
+}
@@ -33,6 +33,14 @@ public:
     void setReuseAddr(bool on); // Enable/disable SO_REUSEADDR
     void setReusePort(bool on); // Enable/disable SO_REUSEPORT
     void setKeepAlive(bool on); // Enable/disable SO_KEEPALIVE
+    bool setBusyPoll(int us); // SO_BUSY_POLL，读socket时在驱动里忙轮询us微秒，超过net.core.busy_read需要CAP_NET_ADMIN
+
+    /**
+     * 给本socket所在的SO_REUSEPORT组挂一个classic BPF程序：按处理软中断的CPU号对numSockets取模，
+     * 选出组内第几个监听socket接收新连接。组内下标就是各socket调用listen()的先后顺序
+     * 只有loop线程绑核、并且网卡RSS把流量分散到这些核上时才有意义
+     */
+    bool attachReusePortCpuSteering(int numSockets);
 
 private:
     const int sockfd_;
@@ -3,6 +3,7 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Socket.h"
+#include "Types.h"
 
 #include <errno.h>
 #include <functional>
@@ -11,6 +12,10 @@
 #include <string.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <cassert>
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop)
@@ -33,39 +38,82 @@ TcpConnection::TcpConnection(EventLoop* loop,
         state_(kConnecting),
         name_(nameArg),
         reading_(true),
-        socket_(new Socket(sockfd)),
-        channel_(new Channel(loop, sockfd)),
+        completionSending_(false),
+        socket_(sockfd),
+        channel_(loop, sockfd),
         localAddr_(localAddr),
         peerAddr_(peerAddr),
-        highWaterMark_(64*1024*1024)  // 64M
+        highWaterMark_(64*1024*1024),  // 64M
+        reportedOutputBytes_(0),
+        inputBuffer_(0) // 空闲连接的输入缓冲区不占内存
 {
     // 下面给出channel设置相应的回调函数，poller给channel通知感兴趣的事件发生了，channel会毁掉相应的操作函数
-    channel_->setReadCallback(
+    channel_.setReadCallback(
         std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(
+    channel_.setWriteCallback(
         std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(
+    channel_.setCloseCallback(
         std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(
+    channel_.setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
     LOG_INFO("TcpConnection::ctor[%s] at fd=%d \n", name_.c_str(), sockfd);
-    socket_->setKeepAlive(true);
+    socket_.setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d \n", name_.c_str(), channel_->fd(),  (int)state_);
+    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d \n", name_.c_str(), channel_.fd(),  (int)state_);
+}
+
+void TcpConnection::setEdgeTriggered(bool on)
+{
+    assert(state_ == kConnecting);
+    if (on && !loop_->supportsEdgeTriggered())
+    {
+        // poll没有边沿触发，常驻的EPOLLOUT会让loop空转，退回水平触发
+        LOG_DEBUG("TcpConnection[%s] poller has no edge-triggered mode, use level-triggered \n", name_.c_str());
+        return;
+    }
+    channel_.setEdgeTriggered(on);
+}
+
+void TcpConnection::setCompletionIo(bool on)
+{
+    assert(state_ == kConnecting);
+    if (on && !loop_->supportsCompletionIo())
+    {
+        LOG_DEBUG("TcpConnection[%s] poller has no completion mode, use readiness \n", name_.c_str());
+        return;
+    }
+    channel_.setCompletionIo(on);
+}
+
+bool TcpConnection::writePending() const
+{
+    return outputBuffer_.readableBytes() > 0 || (!channel_.isEdgeTriggered() && channel_.isWriting());
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
-    loop_->isInLoopThread();
+    if (channel_.isCompletionIo())
+    {
+        handleRecvCompletion(receiveTime);
+        return;
+    }
+    if (channel_.isEdgeTriggered())
+    {
+        handleReadUntilAgain(receiveTime);
+        return;
+    }
+
     int saveErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+    ssize_t n = inputBuffer_.readFd(channel_.fd(), &saveErrno);
     if (n > 0)
     {
+        idleEntry_.touch(); // 有数据到来，重置空闲超时(没设置空闲超时时什么也不做)
         // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        inputBuffer_.releaseMemory(); // 数据都处理完了就不再占用内存
     }
     else if (n == 0)
     {
@@ -79,38 +127,263 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     }
 }
 
-void TcpConnection::handleWrite()
+/**
+ * ET模式：一直读到EAGAIN，读到的数据合并成一次messageCallback_
+ * 为了公平，一次最多读kEdgeTriggeredBudget字节，没读完的放到本轮loop末尾继续读(不会再有新的边沿通知)
+ */
+void TcpConnection::handleReadUntilAgain(Timestamp receiveTime)
 {
-    if (channel_->isWriting())
+    size_t total = 0;
+    bool drained = false;
+    bool peerClosed = false;
+    int saveErrno = 0;
+    while (total < kEdgeTriggeredBudget)
     {
-        int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);   
+        ssize_t n = inputBuffer_.readFd(channel_.fd(), &saveErrno);
         if (n > 0)
         {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) // send completed
+            total += n;
+        }
+        else if (n == 0)
+        {
+            peerClosed = true;
+            break;
+        }
+        else if (saveErrno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            drained = (saveErrno == EAGAIN || saveErrno == EWOULDBLOCK);
+            break;
+        }
+    }
+
+    if (total > 0)
+    {
+        idleEntry_.touch();
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        inputBuffer_.releaseMemory();
+        if (state_ == kDisconnected) // 用户在回调里forceClose了
+        {
+            return;
+        }
+    }
+
+    if (peerClosed)
+    {
+        handleClose();
+    }
+    else if (total >= kEdgeTriggeredBudget)
+    {
+        TcpConnectionPtr conn(shared_from_this());
+        loop_->queueInLoop([conn, receiveTime]() {
+            if (conn->state_ != kDisconnected && conn->channel_.isReading())
             {
-                channel_->disableWriting(); // not writable
-                if (writeCompleteCallback_)
+                conn->handleRead(receiveTime);
+            }
+        });
+    }
+    else if (!drained)
+    {
+        errno = saveErrno;
+        LOG_ERROR("TcpConnection::handleRead");
+        handleError();
+    }
+}
+
+/**
+ * 完成模式：poller已经把数据收进了注册缓冲区，拷贝到inputBuffer_里交给用户
+ * 没有就绪通知，出错以后也不会再有EPOLLHUP，直接关闭连接
+ */
+void TcpConnection::handleRecvCompletion(Timestamp receiveTime)
+{
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    int n = channel_.recvResult();
+    if (n > 0)
+    {
+        inputBuffer_.append(channel_.recvData(), n);
+        idleEntry_.touch();
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        inputBuffer_.releaseMemory();
+    }
+    else if (n == 0)
+    {
+        handleClose();
+    }
+    else
+    {
+        errno = -n;
+        LOG_ERROR("TcpConnection::handleRecvCompletion");
+        handleError();
+        handleClose();
+    }
+}
+
+void TcpConnection::handleWrite()
+{
+    if (channel_.isCompletionIo())
+    {
+        handleSendCompletion();
+        return;
+    }
+    const bool edgeTriggered = channel_.isEdgeTriggered();
+    if (edgeTriggered && outputBuffer_.readableBytes() == 0)
+    {
+        return; // ET模式下EPOLLOUT常驻，输出队列为空时的可写通知直接忽略
+    }
+
+    if (channel_.isWriting())
+    {
+        // LT模式每次可写事件只写一次；ET模式写到EAGAIN或者写满预算为止
+        size_t written = 0;
+        do
+        {
+            int savedErrno = 0;
+            ssize_t n = outputBuffer_.writeFd(channel_.fd(), &savedErrno);   
+            if (n > 0)
+            {
+                written += n;
+                outputBuffer_.retrieve(n);
+                reportOutputBytes();
+                if (outputBuffer_.readableBytes() == 0) // send completed
                 {
-                    // 唤醒loop_对应的thread线程，执行回调
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                    if (!edgeTriggered)
+                    {
+                        channel_.disableWriting(); // not writable
+                    }
+                    if (writeCompleteCallback_)
+                    {
+                        // 唤醒loop_对应的thread线程，执行回调
+                        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                    }
+                    if (state_ == kDisconnecting)
+                    {
+                        shutdownInLoop();
+                    }
+                    return;
                 }
-                if (state_ == kDisconnecting)
+            }
+            else if (n == 0)
+            {
+                // 队首文件分片读到了文件末尾：文件在排队期间被截断，已经发不出约定的字节数，
+                // 对端按长度解析会一直等下去，不能丢掉分片继续发后面的数据，直接关闭连接
+                LOG_ERROR("TcpConnection::handleWrite fd=%d file truncated while queued, closing \n", channel_.fd());
+                handleClose();
+                return;
+            }
+            else if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
+            {
+                return;
+            }
+            else
+            {
+                // 其它错误重试也不会好转(比如文件分片sendfile读出EIO)，LT模式下会一直触发EPOLLOUT空转，关闭连接
+                LOG_ERROR("TcpConnection::handleWrite fd=%d err:%d, closing \n", channel_.fd(), savedErrno);
+                handleClose();
+                return;
+            }
+        } while (edgeTriggered && written < kEdgeTriggeredBudget);
+
+        if (edgeTriggered)
+        {
+            // 预算用完但socket可能仍然可写，不会再有EPOLLOUT边沿，自己排队继续写
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->queueInLoop([conn]() {
+                if (conn->channel_.isWriting())
                 {
-                    shutdownInLoop();
+                    conn->handleWrite();
                 }
-            }
+            });
         }
-        else
-        {
-            LOG_ERROR("TcpConnection::handleErite");
+    }
+    else
+    {
+        LOG_ERROR("TcpConnection fd=%d is down, no more writing \n", channel_.fd());
+    }
+}
+
+
+// 完成模式：一次send完成，retrieve掉发出去的部分，还有数据就接着提交
+void TcpConnection::handleSendCompletion()
+{
+    completionSending_ = false;
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
 
+    int n = channel_.sendResult();
+    if (n > 0)
+    {
+        outputBuffer_.retrieve(n);
+        reportOutputBytes();
+        if (outputBuffer_.readableBytes() > 0)
+        {
+            submitCompletionSend();
+            return;
+        }
+        if (writeCompleteCallback_)
+        {
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        if (state_ == kDisconnecting)
+        {
+            shutdownInLoop();
         }
     }
     else
     {
-        LOG_ERROR("TcpConnection fd=%d is down, no more writing \n", channel_->fd());
+        // EPIPE/ECONNRESET等，数据已经发不出去了
+        errno = n < 0 ? -n : EIO;
+        LOG_ERROR("TcpConnection::handleSendCompletion");
+        handleClose();
+    }
+}
+
+// 把输出队列开头最多一个缓冲区的数据拷贝进poller的发送缓冲区并提交，同一时间只有一个send在内核里
+void TcpConnection::submitCompletionSend()
+{
+    if (completionSending_ || outputBuffer_.readableBytes() == 0)
+    {
+        return;
+    }
+    size_t size = 0;
+    char* buf = loop_->completionSendBuffer(&channel_, &size);
+    int savedErrno = 0;
+    ssize_t n = outputBuffer_.copyOut(buf, size, &savedErrno);
+    if (n <= 0)
+    {
+        if (n == 0)
+        {
+            LOG_ERROR("TcpConnection::submitCompletionSend fd=%d file truncated while queued, closing \n", channel_.fd());
+        }
+        else
+        {
+            errno = savedErrno;
+            LOG_ERROR("TcpConnection::submitCompletionSend");
+        }
+        handleClose();
+        return;
+    }
+    loop_->submitCompletionSend(&channel_, n);
+    completionSending_ = true;
+}
+
+// 输出队列里有了新数据：注册可写事件，完成模式下直接提交send
+void TcpConnection::startWriting()
+{
+    if (channel_.isCompletionIo())
+    {
+        submitCompletionSend();
+    }
+    else if (!channel_.isWriting())
+    {
+        channel_.enableWriting();
     }
 }
 
@@ -119,9 +392,13 @@ void TcpConnection::handleWrite()
 // poller => channel::closeCallback => TcpConnection::handleClose
 void TcpConnection::handleClose()
 {
-    LOG_INFO("fd=%d state=%d \n", channel_->fd(), (int)state_);
+    LOG_INFO("fd=%d state=%d \n", channel_.fd(), (int)state_);
     setState(kDisconnected); // 将状态设置成disconnected
-    channel_->disableAll();
+    channel_.disableAll();
+    if (idleEntry_.linked())
+    {
+        loop_->timingWheel()->cancel(&idleEntry_);
+    }
 
     // 获取当前对象的智能指针
     TcpConnectionPtr connPtr(shared_from_this());
@@ -136,7 +413,7 @@ void TcpConnection::handleError()
     int optval;
     socklen_t optlen = sizeof optval;
     int err = 0;
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
     {
         err = errno;
     }
@@ -156,48 +433,183 @@ void TcpConnection::send(const std::string& buf)
         if (loop_->isInLoopThread())
         {
             sendInLoop(buf.c_str(), buf.size());
-            // buf->retrieveAll();
         }
         else
         {
-            // fp 指向 sendInLoop
-            // void (TcpConnection::*fp)(const void* message, size_t len) = &TcpConnection::sendInLoop;
-            loop_->runInLoop(std::bind(
-                &TcpConnection::sendInLoop,
-                this,
-                buf.c_str(),
-                buf.size()
-            ));
+            // 跨线程时不能引用调用者的内存(调用返回后buf可能就析构了)，拷贝一份交给loop
+            send(std::string(buf));
+        }
+    }
+}
+
+void TcpConnection::send(std::string&& buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendStringInLoop(buf);
+        }
+        else
+        {
+            // 数据move进任务里，不拷贝
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, buf = std::move(buf)]() mutable {
+                conn->sendStringInLoop(buf);
+            });
+        }
+    }
+}
+
+void TcpConnection::send(const void* data, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(data, len);
+        }
+        else
+        {
+            send(std::string(static_cast<const char*>(data), len));
         }
     }
 }
 
+void TcpConnection::send(Buffer* buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendBufferInLoop(*buf);
+        }
+        else
+        {
+            // 直接拿走buf的存储，buf换成一块空的存储，不拷贝数据
+            Buffer stolen;
+            stolen.swap(*buf);
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, stolen = std::move(stolen)]() mutable {
+                conn->sendBufferInLoop(stolen);
+            });
+        }
+    }
+    else
+    {
+        buf->retrieveAll(); // 连接已经断开，数据丢弃，和发送成功一样清空buf
+    }
+}
+
 
 /**
  * 发送数据 应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，而且设置了水位回调
  */
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
-    ssize_t nwrote = 0;
-    ssize_t remaining = len;
-    bool faultError = false;
+    ssize_t nwrote = writeDirectly(data, len);
+    if (nwrote < 0)
+    {
+        return;
+    }
+
+    /**
+     *  说明当前这一次write，并没有把数据全部发送出去，剩余的数据需保存再缓冲区当中
+     *  然后给channel注册epollout事件，poller发现tcp的发送缓冲区有空间，会通知相应的sock-channel
+     *  调用eriteCallback_回调，也就是调用TcpConnection::handleWrite，把发送缓冲区中的数据全部发送完成
+     */
+    size_t remaining = len - nwrote;
+    if (remaining > 0)
+    {
+        checkHighWaterMark(remaining);
+        outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
+        reportOutputBytes();
+        startWriting(); // 这里一定要注册channel的写事件，否则poller不会给channel通知epollout
+    }
+}
+
+// 和sendInLoop一样，只是没发完的数据较大时直接接管data的存储挂到outputBuffer_上，不再拷贝
+void TcpConnection::sendStringInLoop(std::string& data)
+{
+    ssize_t nwrote = writeDirectly(data.data(), data.size());
+    if (nwrote < 0)
+    {
+        return;
+    }
 
+    size_t remaining = data.size() - nwrote;
+    if (remaining > 0)
+    {
+        checkHighWaterMark(remaining);
+        if (remaining >= ChainBuffer::kBlockSize)
+        {
+            auto holder = std::make_shared<std::string>(std::move(data));
+            const char* start = holder->data() + nwrote;
+            outputBuffer_.appendSlice(start, remaining, std::move(holder));
+        }
+        else
+        {
+            outputBuffer_.append(data.data() + nwrote, remaining);
+        }
+        reportOutputBytes();
+        startWriting();
+    }
+}
+
+void TcpConnection::sendBufferInLoop(Buffer& buf)
+{
+    const size_t len = buf.readableBytes();
+    ssize_t nwrote = writeDirectly(buf.peek(), len);
+    if (nwrote < 0)
+    {
+        buf.retrieveAll(); // 数据不再发送，但send(Buffer*)承诺清空buf
+        return;
+    }
+
+    size_t remaining = len - nwrote;
+    if (remaining > 0)
+    {
+        checkHighWaterMark(remaining);
+        if (remaining >= ChainBuffer::kBlockSize)
+        {
+            auto holder = std::make_shared<Buffer>();
+            holder->swap(buf);
+            const char* start = holder->peek() + nwrote;
+            outputBuffer_.appendSlice(start, remaining, std::move(holder));
+        }
+        else
+        {
+            outputBuffer_.append(buf.peek() + nwrote, remaining);
+        }
+        reportOutputBytes();
+        startWriting();
+    }
+    buf.retrieveAll();
+}
+
+/**
+ * 输出队列为空时直接write，返回写出去的字节数(没写或者EAGAIN时为0)
+ * 连接已经shutdown或者对端已经关闭(EPIPE/ECONNRESET)时返回-1，数据不需要再缓存
+ */
+ssize_t TcpConnection::writeDirectly(const void* data, size_t len)
+{
     // 之前调用过该connection的shutdown，不能再进行发送
     if (state_ == kDisconnecting)
     {
         LOG_INFO("disconnected, give up writing!");
-        return;
+        return -1;
     }
 
     // if no thing in output queue, try weiting directly
     // 表示channel_第一次开始写数据，而且缓冲区没有待发送数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // 完成模式不直接write，数据全部进输出队列，由poller提交send
+    ssize_t nwrote = 0;
+    if (!writePending() && !channel_.isCompletionIo())
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        nwrote = ::write(channel_.fd(), data, len);
         if (nwrote >= 0)
         {
-            remaining = len - nwrote;
-            if (remaining == 0 && writeCompleteCallback_)
+            if (implicit_cast<size_t>(nwrote) == len && writeCompleteCallback_)
             {
                 // 既然这里数据全部发送完成，就不用再给channel设置epollout事件
                 loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
@@ -211,36 +623,141 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
                 LOG_INFO("TcpConnection::sendInLoop");
                 if (errno == EPIPE || errno == ECONNRESET) 
                 {
-                    faultError = true;
+                    return -1;
                 }
             }
         }
     }
+    return nwrote;
+}
 
-    /**
-     *  说明当前这一次write，并没有把数据全部发送出去，剩余的数据需保存再缓冲区当中
-     *  然后给channel注册epollout事件，poller发现tcp的发送缓冲区有空间，会通知相应的sock-channel
-     *  调用eriteCallback_回调，也就是调用TcpConnection::handleWrite，把发送缓冲区中的数据全部发送完成
-     */
-    if (!faultError && remaining > 0)
+// remaining字节即将进入outputBuffer_，待发送数据越过高水位时通知用户
+void TcpConnection::checkHighWaterMark(size_t remaining)
+{
+    // 目前发送缓冲区剩余的待发送数据的长度
+    size_t oldlen = outputBuffer_.readableBytes();
+
+    if (oldlen + remaining >= highWaterMark_
+        && oldlen < highWaterMark_
+        && highWaterMarkCallback_)
     {
-        // 目前发送缓冲区剩余的待发送数据的长度
-        size_t oldlen = outputBuffer_.readableBytes();
+        loop_->queueInLoop(
+            std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining));
+    }
+}
+
 
-        if (oldlen + remaining >= highWaterMark_
-            && oldlen < highWaterMark_
-            && highWaterMarkCallback_)
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        // 文件在输出队列中排队期间调用者可能已经关闭了fd，这里持有一份自己的fd
+        int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (dupfd < 0)
         {
-            loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining));
+            LOG_ERROR("TcpConnection::sendFile dup fd=%d err:%d \n", fd, errno);
+            return;
         }
+        loop_->runInLoop(std::bind(
+            &TcpConnection::sendFileInLoop,
+            shared_from_this(),
+            dupfd,
+            offset,
+            len
+        ));
+    }
+}
+
+
+/**
+ * 和sendInLoop的流程一样：输出队列为空时直接sendfile，没发完的部分作为文件分片放到outputBuffer_里，
+ * 由handleWrite在EPOLLOUT时继续sendfile。fd的所有权在这里转交给outputBuffer_
+ */
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len)
+{
+    size_t remaining = len;
+
+    if (state_ == kDisconnecting || state_ == kDisconnected)
+    {
+        LOG_INFO("disconnected, give up sending file!");
+        ::close(fd);
+        return;
+    }
+
+    // 只接受普通文件：socket/管道不能作为sendfile的源(EINVAL)，排进队列后handleWrite会一直失败。
+    // 丢掉这段数据会让对端按长度解析时错位，所以直接关闭连接
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+    {
+        LOG_ERROR("TcpConnection::sendFileInLoop fd=%d source is not a regular file, closing \n", channel_.fd());
+        ::close(fd);
+        handleClose();
+        return;
+    }
+
+    // 只发到文件末尾，否则sendfile在文件末尾一直返回0，分片永远发不完
+    off_t available = offset < st.st_size ? st.st_size - offset : 0;
+    if (len > static_cast<size_t>(available))
+    {
+        LOG_ERROR("TcpConnection::sendFileInLoop len=%lu past end of file, clamped to %ld \n", len, (long)available);
+        len = available;
+        remaining = len;
+    }
 
-        outputBuffer_.append((char*)data + nwrote, remaining);
-        if (!channel_->isWriting())
+    if (!writePending() && !channel_.isCompletionIo())
+    {
+        ssize_t nwrote = ::sendfile(channel_.fd(), fd, &offset, len); // offset会被推进
+        if (nwrote == 0 && len > 0)
+        {
+            // fstat之后文件被截断了
+            LOG_ERROR("TcpConnection::sendFileInLoop fd=%d file truncated, closing \n", channel_.fd());
+            ::close(fd);
+            handleClose();
+            return;
+        }
+        else if (nwrote >= 0)
+        {
+            remaining = len - nwrote;
+            if (remaining == 0 && writeCompleteCallback_)
+            {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+        }
+        else // nwrote < 0
         {
-            channel_->enableWriting(); // 这里一定要注册channel的写事件，否则poller不会给channel通知epollout
+            if (errno != EWOULDBLOCK)
+            {
+                // EPIPE/ECONNRESET/EIO：这段数据发不出去了，后面的数据也不能再发
+                LOG_ERROR("TcpConnection::sendFileInLoop err:%d, closing \n", errno);
+                ::close(fd);
+                handleClose();
+                return;
+            }
         }
     }
+
+    if (remaining == 0)
+    {
+        ::close(fd);
+        return;
+    }
+
+    checkHighWaterMark(remaining);
+    outputBuffer_.appendFile(fd, offset, remaining);
+    reportOutputBytes();
+    startWriting();
+}
+
+
+// outputBuffer_长度变化后把差值汇报给所属loop，负载均衡可以按loop的待发送字节数选择
+void TcpConnection::reportOutputBytes()
+{
+    size_t bytes = outputBuffer_.readableBytes();
+    if (bytes != reportedOutputBytes_)
+    {
+        loop_->addPendingOutputBytes(static_cast<int64_t>(bytes) - static_cast<int64_t>(reportedOutputBytes_));
+        reportedOutputBytes_ = bytes;
+    }
 }
 
 
@@ -250,8 +767,8 @@ void TcpConnection::connectEstablished()
     assert(state_ == kConnecting);
 
     setState(kConnected);
-    channel_->tie(shared_from_this());
-    channel_->enableReading(); // 向poller注册channel的epollin事件
+    channel_.tie(shared_from_this());
+    channel_.enableReading(); // 向poller注册channel的epollin事件
 
     // 新连接建立，执行回调
     connectionCallback_(shared_from_this());   
@@ -263,11 +780,18 @@ void TcpConnection::connectDestroyed() // 这个if语句一般情况下是进不
     if (state_ == kConnected) 
     {
         setState(kDisconnected);
-        channel_->disableAll(); // 把channel的所有感兴趣的事件，从poller中del
+        channel_.disableAll(); // 把channel的所有感兴趣的事件，从poller中del
 
         connectionCallback_(shared_from_this());
     }
-    channel_->remove(); // 把channel从poller中删除 【大概只有这句是能运行的】！！！
+    if (idleEntry_.linked())
+    {
+        loop_->timingWheel()->cancel(&idleEntry_);
+    }
+    // 没发完的数据不会再发了，从loop的统计里扣掉
+    loop_->addPendingOutputBytes(-static_cast<int64_t>(reportedOutputBytes_));
+    reportedOutputBytes_ = 0;
+    channel_.remove(); // 把channel从poller中删除 【大概只有这句是能运行的】！！！
 }
 
 
@@ -284,10 +808,63 @@ void TcpConnection::shutdown()
 } 
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting()) // 说明outputBuffer中的数据已经全部发送完成
+    if (!writePending()) // 说明outputBuffer中的数据已经全部发送完成
+    {
+        socket_.shutdownWrite(); // 关闭写端
+    }
+}
+
+
+// 强制关闭连接，不管输出缓冲区里还有没有数据
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this())
+        );
+    }
+}
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose(); // 和对端关闭连接走同样的流程
+    }
+}
+
+
+void TcpConnection::setIdleTimeout(double seconds)
+{
+    loop_->runInLoop(
+        std::bind(&TcpConnection::setIdleTimeoutInLoop, shared_from_this(), seconds)
+    );
+}
+void TcpConnection::setIdleTimeoutInLoop(double seconds)
+{
+    TimingWheel* wheel = loop_->timingWheel();
+    if (seconds <= 0.0)
+    {
+        wheel->cancel(&idleEntry_);
+        return;
+    }
+    if (state_ != kConnected)
     {
-        socket_->shutdownWrite(); // 关闭写端
+        return;
     }
+
+    // 时间轮不能持有TcpConnection的强引用，否则连接永远不会析构
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    idleEntry_.setCallback([weakConn]() {
+        TcpConnectionPtr conn = weakConn.lock();
+        if (conn)
+        {
+            LOG_INFO("TcpConnection[%s] idle timeout, force close \n", conn->name().c_str());
+            conn->forceCloseInLoop();
+        }
+    });
+    wheel->schedule(&idleEntry_, seconds);
 }
 
 
@@ -313,7 +890,13 @@ const char* TcpConnection::stateToString() const
 
 void TcpConnection::setTcpNoDelay(bool on)
 {
-    socket_->setTcpNoDelay(on);
+    socket_.setTcpNoDelay(on);
+}
+
+
+void TcpConnection::setBusyPoll(int us)
+{
+    socket_.setBusyPoll(us);
 }
 
 
@@ -323,9 +906,9 @@ void TcpConnection::startRead()
 }
 void TcpConnection::startReadInLoop()
 {
-    if (!reading_ || !channel_->isReading())
+    if (!reading_ || !channel_.isReading())
     {
-        channel_->enableReading();
+        channel_.enableReading();
         reading_ = true;
     }
 }
@@ -336,9 +919,9 @@ void TcpConnection::stopRead()
 }
 void TcpConnection::stopReadInLoop()
 {
-    if (reading_ || channel_->isReading())
+    if (reading_ || channel_.isReading())
     {
-        channel_->disableReading();
+        channel_.disableReading();
         reading_ = false;
     }
 }
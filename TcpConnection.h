@@ -4,16 +4,18 @@
 
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "ChainBuffer.h"
 #include "InetAddress.h"
+#include "Socket.h"
+#include "Channel.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
 
 #include <memory>
 #include <atomic>
 #include <cstring>
 
-class Channel;
 class EventLoop;
-class Socket;
 
 /**
  * logical idea:
@@ -35,9 +37,44 @@ public:
                   const InetAddress& peerAddr);
     ~TcpConnection();
     
-    // void send(std::string&& message); C++11
+    /**
+     * 发送数据，线程安全
+     * 在loop线程中调用时直接写socket，一次写完不会有任何内存分配；
+     * 跨线程调用时数据被move(或者拷贝一份)进投递给loop的任务里，不会引用调用者的内存
+     */
     void send(const std::string& data);
+    void send(std::string&& data); // 数据没能一次写完时直接接管string的存储，不再拷贝
+    void send(const void* data, size_t len);
+    void send(Buffer* buf); // 发送buf中所有可读数据并清空buf，跨线程时直接拿走buf的存储
+    /**
+     * 发送文件fd中从offset开始的len字节，和send的数据按调用顺序排在同一个输出队列里
+     * 用sendfile(2)发送，数据不经过用户态；内部会dup一份fd，调用返回后调用者就可以关闭自己的fd
+     * fd必须是普通文件，否则连接会被关闭；len会被截到文件末尾；排队期间文件被截断导致发不满时，连接会被关闭
+     */
+    void sendFile(int fd, off_t offset, size_t len);
     void shutdown();  // close the connection
+    void forceClose(); // 不等待输出缓冲区发送完，直接关闭连接
+
+    /**
+     * 设置空闲超时：seconds秒内没有收到任何数据就forceClose，每次handleRead都会重置计时
+     * 挂在所属loop的时间轮上，重置是O(1)的，不分配内存；seconds <= 0 表示取消空闲超时
+     */
+    void setIdleTimeout(double seconds);
+
+    /**
+     * 使用边沿触发(EPOLLET)：读写都一直做到EAGAIN，EPOLLOUT第一次注册后不再反复开关，省掉epoll_ctl
+     * 只能在connectEstablished之前设置(TcpServer::setEdgeTriggered)
+     */
+    void setEdgeTriggered(bool on);
+    // ET模式下一次事件最多读/写的字节数，超过后把剩下的工作排到loop后面，避免一个连接饿死其他连接
+    static const size_t kEdgeTriggeredBudget = 256 * 1024;
+
+    /**
+     * 使用io_uring的完成模式收发(见UringPoller)：不再等就绪通知后read/write，
+     * 而是由poller提交注册缓冲区上的recv/send，和poll合并在同一次系统调用里
+     * poller不支持时(epoll/poll)保持原来的就绪模式；只能在connectEstablished之前设置(TcpServer::setCompletionIo)
+     */
+    void setCompletionIo(bool on);
 
     void connectEstablished(); // called when TcpServer accepts a new connection (should be called only once)
     void connectDestroyed(); // called when TcpServer has removed me from its map (should be called only once)
@@ -60,7 +97,7 @@ public:
     { closeCallback_ = std::move(cb); }
 
     Buffer* inputBuffer() { return &inputBuffer_; }
-    Buffer* outputBuffer() { return &outputBuffer_; }
+    ChainBuffer* outputBuffer() { return &outputBuffer_; }
 
     EventLoop* getloop() const { return loop_; }
     const std::string& name() const { return name_; }
@@ -74,6 +111,7 @@ public:
 
     const char* stateToString() const;
     void setTcpNoDelay(bool on);
+    void setBusyPoll(int us); // SO_BUSY_POLL
     void startRead();
     void startReadInLoop();
     void stopRead();
@@ -83,21 +121,38 @@ private:
     enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
     void setState(StateE s) { state_ = s; }
     void handleRead(Timestamp receiveTime);
+    void handleReadUntilAgain(Timestamp receiveTime);
+    void handleRecvCompletion(Timestamp receiveTime);
     void handleWrite();
+    void handleSendCompletion();
+    void submitCompletionSend();
+    void startWriting();
     void handleClose();
     void handleError();
 
     void sendInLoop(const void* data, size_t len);
+    void sendStringInLoop(std::string& data);
+    void sendBufferInLoop(Buffer& buf);
+    ssize_t writeDirectly(const void* data, size_t len);
+    void checkHighWaterMark(size_t remaining);
+    // 输出队列里还有没发完的数据(ET模式下EPOLLOUT常驻，不能再用isWriting()判断)
+    bool writePending() const;
+    void reportOutputBytes();
+    void sendFileInLoop(int fd, off_t offset, size_t len);
     void shutdownInLoop();
+    void forceCloseInLoop();
+    void setIdleTimeoutInLoop(double seconds);
 
     EventLoop* loop_; // 这里绝不是baseloop, TcpConnection都是在subloop里管理的
     const std::string name_;
     std::atomic_int state_;
     bool reading_;
+    bool completionSending_; // 完成模式下有一个send在内核里
 
     // 这里和Acceptor类似 Acceptor=> mainloop  |  TcpConnection=> subloop 
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    // 直接作为成员，和TcpConnection一起分配，channel_先于socket_析构(fd最后关闭)
+    Socket socket_;
+    Channel channel_;
 
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
@@ -109,9 +164,12 @@ private:
     CloseCallback closeCallback_;
 
     size_t highWaterMark_;
+    size_t reportedOutputBytes_; // 已经计入loop_->pendingOutputBytes()的字节数
+
+    TimingWheel::Entry idleEntry_; // 空闲超时，挂在loop_->timingWheel()上
 
     Buffer inputBuffer_; //接受数据缓冲区
-    Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer. 发送数据缓冲区
+    ChainBuffer outputBuffer_; // 发送数据缓冲区，分片链表 + writev，大数据不会整体搬移
 };
 
 //typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
\ No newline at end of file
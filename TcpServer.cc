@@ -1,7 +1,10 @@
 #include "TcpServer.h"
 #include "Logger.h"
+#include "SlabAllocator.h"
 
 #include <string.h>
+#include <future>
+#include <algorithm>
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop)
 {
@@ -33,12 +36,17 @@ TcpServer::TcpServer(EventLoop* loop,
                 : loop_(CheckLoopNotNull(loop))
                 , ipPort_(listenAddr.toIpPort())
                 , name_(nameArg)
-                , acceptor_(new Acceptor(loop, listenAddr, option == kReusePort))
-                , threadPool_(new EventLoopThreadPool(loop, name_)) // 线程池对象创建{未开启线程}，默认main
+                , option_(option)
+                , acceptor_(new Acceptor(loop, listenAddr, option != kNoReusePort))
+                , cpuSteering_(false)
+                , edgeTriggered_(false)
+                , completionIo_(false)
+                , busyPollUs_(0)
                 , connectionCallback_()
                 , messageCallback_()
-                , nextConnId_(1)
                 , started_(0)
+                , nextConnId_(1)
+                , threadPool_(new EventLoopThreadPool(loop, name_)) // 线程池对象创建{未开启线程}，默认main
 {
     /**
      * 当有新用户连接时，会执行TcpServer::newConnection回调
@@ -46,6 +54,8 @@ TcpServer::TcpServer(EventLoop* loop,
      */
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, 
         std::placeholders::_1, std::placeholders::_2));
+    acceptor_->setNewConnectionBatchCallback(std::bind(&TcpServer::newConnectionBatch, this,
+        std::placeholders::_1));
 }
 
 
@@ -53,15 +63,38 @@ TcpServer::~TcpServer()
 {
     LOG_INFO("TcpServer::~TcpServer [%s] \n", name_.c_str());
 
-    for (auto& item : connections_)
+    // subloop上的Acceptor必须在它自己的loop线程里注销channel，这里同步等它们析构完，之后不会再有新连接进来
+    for (auto& item : loopAcceptors_)
+    {
+        Acceptor* acceptor = item.second.release();
+        std::promise<void> destroyed;
+        item.first->runInLoop([acceptor, &destroyed]() {
+            delete acceptor;
+            destroyed.set_value();
+        });
+        destroyed.get_future().wait();
+    }
+
+    // 连接表只能由所属loop访问，和Acceptor一样到各个loop上销毁连接并等待完成
+    for (auto& item : loopConnections_)
     {
-        // 这个局部的share_ptr智能指针对象，出右括号，可以自动释放new出来TcpConnection对象资源了
-        TcpConnectionPtr conn(item.second);
-        item.second.reset();
-        // 销毁连接
-        conn->getloop()->runInLoop(
-            std::bind(&TcpConnection::connectDestroyed, conn)
-        );
+        ConnectionMap* connections = &item.second;
+        std::promise<void> destroyed;
+        item.first->runInLoop([connections, &destroyed]() {
+            ConnectionMap local;
+            local.swap(*connections);
+            for (auto& entry : local)
+            {
+                // 这个局部的share_ptr智能指针对象，出右括号，可以自动释放new出来TcpConnection对象资源了
+                TcpConnectionPtr conn(entry.second);
+                conn->getloop()->addConnections(-1);
+                entry.second.reset();
+                // 销毁连接
+                conn->connectDestroyed();
+            }
+            destroyed.set_value();
+        });
+        destroyed.get_future().wait();
     }
 }
 
@@ -80,7 +113,52 @@ void TcpServer::start()
     if (started_++ == 0) // 防止一个TcpServer对象被start多次
     { 
         threadPool_->start(threadInitCallback_); // 启动底层loop线程池并开启子线程loop.loop()
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get())); // 将accptorChannel注册在mainloop的poller上
+        for (EventLoop* ioLoop : threadPool_->getAllLoops())
+        {
+            loopConnections_[ioLoop]; // 先建好每个loop的表，之后各loop只查找不插入
+        }
+        if (option_ == kReusePortPerLoop && threadPool_->getAllLoops().front() != loop_)
+        {
+            startPerLoopAcceptors();
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get())); // 将accptorChannel注册在mainloop的poller上
+        }
+    }
+}
+
+/**
+ * kReusePortPerLoop: 构造函数里的acceptor_只负责尽早bind(端口被占用时在构造阶段就报错)，并不listen，
+ * 所以不会被内核选中。真正接收连接的是每个subloop上各自的Acceptor
+ */
+void TcpServer::startPerLoopAcceptors()
+{
+    // 用acceptor_实际绑定的地址，listenAddr端口为0时所有socket也能落在同一个端口上
+    InetAddress listenAddr(getLocalAddr(acceptor_->acceptSocket().fd()));
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    for (EventLoop* ioLoop : loops)
+    {
+        std::unique_ptr<Acceptor> acceptor(new Acceptor(ioLoop, listenAddr, true));
+        acceptor->setNewConnectionCallback([this, ioLoop](int sockfd, const InetAddress& peerAddr) {
+            ioLoop->addConnections(1);
+            createConnection(ioLoop, sockfd, peerAddr);
+        });
+
+        // 逐个listen并等待完成，保证reuseport组内socket的顺序就是loops的顺序(CPU steering按这个下标选socket)
+        Acceptor* raw = acceptor.get();
+        std::promise<void> listened;
+        ioLoop->runInLoop([raw, &listened]() {
+            raw->listen();
+            listened.set_value();
+        });
+        listened.get_future().wait();
+        loopAcceptors_.emplace_back(ioLoop, std::move(acceptor));
+    }
+
+    if (cpuSteering_)
+    {
+        loopAcceptors_.front().second->acceptSocket().attachReusePortCpuSteering(static_cast<int>(loops.size()));
     }
 }
 /*-------------------------------------------------------------------*/
@@ -96,13 +174,64 @@ void TcpServer::start()
  */
 
 // （mainloop处理）有一个新的客户端的来连接，acceptor会执行这个回调【会把客户端的sockfd和Ip端口号传给这个回调】（宛如向上级汇报）
+void TcpServer::setLoadBalancePolicy(LoadBalancer::Policy policy)
+{
+    threadPool_->setLoadBalancer(LoadBalancer::newLoadBalancer(policy));
+}
+
+// 选好loop马上计数，同一批里后面的连接就能看到前面的分配结果
+EventLoop* TcpServer::selectLoop(const InetAddress& peerAddr)
+{
+    EventLoop* ioLoop = threadPool_->selectLoop(peerAddr);
+    ioLoop->addConnections(1);
+    return ioLoop;
+}
+
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
-    // 轮询算法，选择一个subloop来管理channel
-    EventLoop* ioLoop = threadPool_->getNextLoop();
+    // 按负载均衡策略(默认轮询)选择一个subloop来管理channel，TcpConnection在subloop上构造
+    EventLoop* ioLoop = selectLoop(peerAddr);
+    ioLoop->runInLoop(std::bind(&TcpServer::createConnection, this, ioLoop, sockfd, peerAddr));
+}
+
+/**
+ * baseloop只负责accept和给fd选loop：同一批连接按目标loop分组，每个loop只投递一个任务(最多一次eventfd唤醒)，
+ * 创建TcpConnection、getsockname等工作都放到subloop上做
+ */
+void TcpServer::newConnectionBatch(const std::vector<Acceptor::AcceptedConnection>& conns)
+{
+    using ConnectionList = std::vector<Acceptor::AcceptedConnection>;
+    std::vector<std::pair<EventLoop*, ConnectionList>> groups;
+    for (const Acceptor::AcceptedConnection& item : conns)
+    {
+        EventLoop* ioLoop = selectLoop(item.second);
+        auto it = std::find_if(groups.begin(), groups.end(),
+            [ioLoop](const std::pair<EventLoop*, ConnectionList>& group) { return group.first == ioLoop; });
+        if (it == groups.end())
+        {
+            groups.emplace_back(ioLoop, ConnectionList());
+            it = groups.end() - 1;
+        }
+        it->second.push_back(item);
+    }
+
+    for (auto& group : groups)
+    {
+        EventLoop* ioLoop = group.first;
+        ioLoop->runInLoop([this, ioLoop, list = std::move(group.second)]() {
+            for (const Acceptor::AcceptedConnection& item : list)
+            {
+                createConnection(ioLoop, item.first, item.second);
+            }
+        });
+    }
+}
+
+// 总是在ioLoop线程上调用，TcpConnection从构造开始就只属于这个loop
+void TcpServer::createConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
     char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
+    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_++);
     std::string connName = name_ + buf;
 
     LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
@@ -112,26 +241,35 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
     InetAddress localAddr(getLocalAddr(sockfd));
 
     // 根据连接成功的sockfd，创建TcpConnection连接对象
-    TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-    connections_[connName] = conn;
+    // 对象和shared_ptr的控制块一起从ioLoop的SlabAllocator分配，断开后的内存留给下一个连接
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(
+        SlabStlAllocator<TcpConnection>(), ioLoop, connName, sockfd, localAddr, peerAddr);
+    loopConnections_.find(ioLoop)->second[connName] = conn;
     // 下面的回调都是用户设置给TcpServer => TcpConnection => Channel => Poller => notify channel调用回调
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    conn->setCompletionIo(completionIo_);
+    if (busyPollUs_ > 0)
+    {
+        conn->setBusyPoll(busyPollUs_);
+    }
 
     // 设置了如何关闭连接的回调
     conn->setCloseCallback(
         std::bind(&TcpServer::removeConnection, this, std::placeholders::_1)
     );
 
-    // 直接调用TcpConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    // 已经在ioLoop线程里了，直接调用TcpConnection::connectEstablished
+    conn->connectEstablished();
 }
 
 
+// 连接登记在它所属loop的表里，删除也在那个loop上做，不用再绕回baseloop
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
-    loop_->runInLoop(
+    conn->getloop()->runInLoop(
         std::bind(&TcpServer::removeConnectionInLoop, this, conn)
     );
 }
@@ -140,9 +278,9 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
     LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection [%s] \n",
         name_.c_str(), conn->name().c_str());
 
-    size_t n = connections_.erase(conn->name());
-
     EventLoop* ioLoop = conn->getloop();
+    loopConnections_.find(ioLoop)->second.erase(conn->name());
+    ioLoop->addConnections(-1);
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn)
     );
@@ -13,6 +13,7 @@
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
 
 // TCP server, supports single-threaded and thread-pool models.
 class TcpServer : noncopyable
@@ -24,6 +25,11 @@ public:
     {
         kNoReusePort,
         kReusePort,
+        /**
+         * 每个subloop各自持有一个绑定同一地址的SO_REUSEPORT监听socket和Acceptor，
+         * 由内核在它们之间分发新连接，accept和后续的读写都在同一个线程完成，不再经过baseloop转手
+         */
+        kReusePortPerLoop,
     };
 
     TcpServer(EventLoop* loop,
@@ -35,6 +41,8 @@ public:
     const std::string& ipPort() { return ipPort_; }
     const std::string& name() { return name_; }
     EventLoop* getLoop() { return loop_; }
+    // 用来在start()之前设置线程池的绑核、调度策略等选项
+    std::shared_ptr<EventLoopThreadPool> threadPool() { return threadPool_; }
 
     void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = std::move(cb); }
     void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = std::move(cb); }
@@ -44,11 +52,30 @@ public:
     // set底层SubLoop的个数
     void setThreadNum(int numThreads);
 
+    // 新建立的连接使用边沿触发(EPOLLET)，必须在start()之前设置
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    // 新建立的连接使用io_uring完成模式收发(MUDUO_USE_URING时有效，其他poller忽略)，必须在start()之前设置
+    void setCompletionIo(bool on) { completionIo_ = on; }
+
+    // 新连接的socket设置SO_BUSY_POLL(微秒)，0表示不设置，配合EventLoop::setSpinPollUs使用
+    void setBusyPollUs(int us) { busyPollUs_ = us; }
+
+    // 新连接分配到subloop的策略，默认轮询，必须在start()之前设置
+    void setLoadBalancePolicy(LoadBalancer::Policy policy);
+
+    // kReusePortPerLoop模式下按CPU号挑选监听socket(SO_ATTACH_REUSEPORT_CBPF)，必须在start()之前设置
+    void setReusePortCpuSteering(bool on) { cpuSteering_ = on; }
+
     // 开启Server监听
     void start();
 
 private:
     void newConnection(int sockfd, const InetAddress& peerAddr); // 给 Acceptor::handleRead 传递的[对新连接对象处理]的回调函数! 
+    void newConnectionBatch(const std::vector<Acceptor::AcceptedConnection>& conns); // Acceptor一次可读事件accept到的所有连接
+    void createConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr); // 创建TcpConnection并交给ioLoop
+    void startPerLoopAcceptors();
+    EventLoop* selectLoop(const InetAddress& peerAddr);
     void removeConnection(const TcpConnectionPtr& conn);
     void removeConnectionInLoop(const TcpConnectionPtr& conn);
 
@@ -59,8 +86,14 @@ private:
     EventLoop* loop_; // baseloop 用户定义的loop [the acceptor loop]
     const std::string ipPort_;
     const std::string name_;
+    const Option option_;
     std::unique_ptr<Acceptor> acceptor_; // run in mainLoop，任务是监听新连接事件
-    std::shared_ptr<EventLoopThreadPool> threadPool_; // one loop per thread
+    // kReusePortPerLoop: 每个subloop一个Acceptor，只能在各自的loop线程里析构
+    std::vector<std::pair<EventLoop*, std::unique_ptr<Acceptor>>> loopAcceptors_;
+    bool cpuSteering_;
+    bool edgeTriggered_;
+    bool completionIo_;
+    int busyPollUs_;
 
     ConnectionCallback connectionCallback_; // 有新连接的回调
     MessageCallback messageCallback_; // 有读写消息时的回调
@@ -69,6 +102,10 @@ private:
     ThreadInitCallback threadInitCallback_; // loop线程初始化的回调
     std::atomic_int started_;
 
-    int nextConnId_;
-    ConnectionMap connections_; // save all connections
+    std::atomic_int nextConnId_;
+    // 每个loop一张连接表，start()之后结构不再变化，每张表只由它所属的loop线程增删，不需要加锁
+    std::unordered_map<EventLoop*, ConnectionMap> loopConnections_;
+
+    // 放在最后声明，最先析构：loop线程先退出，之后才析构它们会访问的连接表和回调
+    std::shared_ptr<EventLoopThreadPool> threadPool_; // one loop per thread
 };
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "CurrentThread.h"
 
 #include <semaphore.h>
+#include <pthread.h>
 
 // atomic_int复制构造函数(被删除)来初始化 -》 std::atomic_int stop = std::atomic_int(0); error
 std::atomic_int Thread::numCreated_{0}; // 或者numCreated_(0)
@@ -33,6 +34,8 @@ void Thread::start()
     thread_ = std::shared_ptr<std::thread>(new std::thread([&](){
         // 获取当前线程的tid
         tid_ = CurrentThread::tid();
+        // 内核里的线程名(top -H / perf / gdb里看到的)，最长15个字符
+        ::pthread_setname_np(::pthread_self(), name_.substr(0, 15).c_str());
         sem_post(&sem);
         // 开启一个新线程，专门执行该线程函数
         func_(); 
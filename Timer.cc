@@ -0,0 +1,32 @@
+#include "Timer.h"
+
+std::atomic<int64_t> Timer::s_numCreated_{0};
+
+void Timer::restart(Timestamp now)
+{
+    if (repeat_)
+    {
+        expiration_ = addTime(now, interval_);
+    }
+    else
+    {
+        expiration_ = Timestamp::invalid();
+    }
+}
+
+void Timer::release()
+{
+    callback_ = TimerCallback();
+    sequence_ = 0;
+    heapIndex_ = -1;
+}
+
+void Timer::reuse(TimerCallback cb, Timestamp when, double interval)
+{
+    callback_ = std::move(cb);
+    expiration_ = when;
+    interval_ = interval;
+    repeat_ = interval > 0.0;
+    sequence_ = ++s_numCreated_;
+    heapIndex_ = -1;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+#include <atomic>
+
+// 定时器对象，由TimerQueue负责管理，用户通过TimerId间接操作
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++s_numCreated_)
+        , heapIndex_(-1)
+    {}
+
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    // 0表示定时器已经失效(被取消，或者已经释放等待复用)，持有旧序号的TimerId都对不上
+    int64_t sequence() const { return sequence_; }
+
+    // 重复定时器到期后，从now开始重新计算下一次到期时间
+    void restart(Timestamp now);
+
+    // 回调正在执行时被取消：只让序号失效，回调执行完以后再由TimerQueue释放
+    void invalidate() { sequence_ = 0; }
+    // 释放回调持有的资源并让序号失效，Timer对象留给TimerQueue复用
+    void release();
+    // 复用一个已经release的Timer，分配新的序号
+    void reuse(TimerCallback cb, Timestamp when, double interval);
+
+    // 在TimerQueue最小堆中的下标，-1表示当前不在堆中
+    int heapIndex() const { return heapIndex_; }
+    void setHeapIndex(int idx) { heapIndex_ = idx; }
+
+    static int64_t numCreated() { return s_numCreated_; }
+
+private:
+    TimerCallback callback_;
+    Timestamp expiration_;
+    double interval_; // 重复间隔(秒)，<= 0 表示一次性定时器
+    bool repeat_;
+    int64_t sequence_; // 全局唯一序号，TimerId通过它识别定时器
+    int heapIndex_;
+
+    static std::atomic<int64_t> s_numCreated_;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+/**
+ * 对外暴露的定时器标识，用于EventLoop::cancel取消定时器
+ * 保存Timer指针和它的全局序号。Timer失效后不会被释放，只会被TimerQueue复用(换一个新序号)，
+ * 所以cancel时解引用指针是安全的，序号对不上说明原来的定时器已经到期或者被取消了
+ */
+class TimerId
+{
+public:
+    TimerId() : timer_(nullptr), sequence_(0) {}
+    TimerId(Timer* timer, int64_t seq) : timer_(timer), sequence_(seq) {}
+
+    int64_t sequence() const { return sequence_; }
+
+    friend class TimerQueue;
+private:
+    Timer* timer_;
+    int64_t sequence_;
+};
@@ -0,0 +1,288 @@
+#include "TimerQueue.h"
+#include "Timer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+
+static int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0)
+    {
+        LOG_FATAL("%s:%s:%d timerfd_create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return timerfd;
+}
+
+// 距离when还有多久，最少100微秒，避免timerfd_settime传入0导致定时器被关闭
+static struct timespec howMuchTimeFromNow(Timestamp when)
+{
+    int64_t microseconds = when.microSecondsSinceEpoch()
+                           - Timestamp::now().microSecondsSinceEpoch();
+    if (microseconds < 100)
+    {
+        microseconds = 100;
+    }
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+    ts.tv_nsec = static_cast<long>((microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+    return ts;
+}
+
+static void readTimerfd(int timerfd)
+{
+    uint64_t howmany;
+    ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
+    if (n != sizeof howmany)
+    {
+        LOG_ERROR("TimerQueue::handleRead() reads %ld bytes instead of 8 \n", n);
+    }
+}
+
+// 把timerfd重新设置为expiration时刻到期
+static void resetTimerfd(int timerfd, Timestamp expiration)
+{
+    struct itimerspec newValue;
+    struct itimerspec oldValue;
+    memset(&newValue, 0, sizeof newValue);
+    memset(&oldValue, 0, sizeof oldValue);
+    newValue.it_value = howMuchTimeFromNow(expiration);
+    if (::timerfd_settime(timerfd, 0, &newValue, &oldValue) < 0)
+    {
+        LOG_ERROR("timerfd_settime error:%d \n", errno);
+    }
+}
+
+/*------------------------------------------------------*/
+
+TimerQueue::TimerQueue(EventLoop* loop)
+    : loop_(loop)
+    , timerfd_(createTimerfd())
+    , timerfdChannel_(loop, timerfd_)
+    , callingExpiredTimers_(false)
+{
+    timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+    // 和wakeupfd一样，timerfd也一直监听读事件
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+    for (const Entry& entry : heap_)
+    {
+        delete entry.timer;
+    }
+    for (Timer* timer : freeTimers_)
+    {
+        delete timer;
+    }
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval)
+{
+    Timer* timer;
+    if (loop_->isInLoopThread() && !freeTimers_.empty())
+    {
+        timer = freeTimers_.back();
+        freeTimers_.pop_back();
+        timer->reuse(std::move(cb), when, interval);
+    }
+    else
+    {
+        timer = new Timer(std::move(cb), when, interval);
+    }
+    // 必须在投递任务之前取序号：跨线程调用时，投递之后loop线程可能马上就让定时器到期并复用它
+    TimerId timerId(timer, timer->sequence());
+    loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
+    return timerId;
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::addTimerInLoop(Timer* timer)
+{
+    bool earliestChanged = heap_.empty()
+                           || timer->expiration().microSecondsSinceEpoch() < heap_[0].when;
+    heapPush(timer);
+
+    if (earliestChanged)
+    {
+        resetTimerfd(timerfd_, timer->expiration());
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId)
+{
+    Timer* timer = timerId.timer_;
+    if (timer == nullptr || timer->sequence() != timerId.sequence_)
+    {
+        return; // 已经到期或者已经被取消了(Timer可能已经被复用成别的定时器)
+    }
+
+    if (timer->heapIndex() >= 0)
+    {
+        heapRemove(timer->heapIndex());
+        releaseTimer(timer);
+    }
+    else
+    {
+        // 定时器正在expired_里执行回调(比如在自己的回调里cancel自己)，回调不能在执行中析构，交给reset释放
+        assert(callingExpiredTimers_);
+        timer->invalidate();
+    }
+}
+
+void TimerQueue::handleRead()
+{
+    Timestamp now(Timestamp::now());
+    readTimerfd(timerfd_);
+
+    getExpired(now);
+
+    callingExpiredTimers_ = true;
+    for (Timer* timer : expired_)
+    {
+        timer->run();
+    }
+    callingExpiredTimers_ = false;
+
+    reset(now);
+}
+
+void TimerQueue::getExpired(Timestamp now)
+{
+    expired_.clear();
+    while (!heap_.empty() && heap_[0].when <= now.microSecondsSinceEpoch())
+    {
+        Timer* timer = heap_[0].timer;
+        heapRemove(0);
+        expired_.push_back(timer);
+    }
+}
+
+void TimerQueue::reset(Timestamp now)
+{
+    for (Timer* timer : expired_)
+    {
+        if (timer->repeat() && timer->sequence() != 0) // 回调里没有被取消
+        {
+            timer->restart(now);
+            heapPush(timer);
+        }
+        else
+        {
+            releaseTimer(timer);
+        }
+    }
+    expired_.clear();
+
+    if (!heap_.empty())
+    {
+        resetTimerfd(timerfd_, heap_[0].timer->expiration());
+    }
+}
+
+void TimerQueue::releaseTimer(Timer* timer)
+{
+    timer->release();
+    freeTimers_.push_back(timer);
+}
+
+/*------------------------------ 4叉最小堆 ------------------------------*/
+// 4叉堆比2叉堆层数少一半，一个节点的4个孩子通常在同一条cache line上
+
+void TimerQueue::heapPush(Timer* timer)
+{
+    heap_.push_back(Entry{timer->expiration().microSecondsSinceEpoch(), timer});
+    int index = static_cast<int>(heap_.size()) - 1;
+    timer->setHeapIndex(index);
+    siftUp(index);
+}
+
+void TimerQueue::heapRemove(int index)
+{
+    assert(index >= 0 && static_cast<size_t>(index) < heap_.size());
+    heap_[index].timer->setHeapIndex(-1);
+
+    int last = static_cast<int>(heap_.size()) - 1;
+    if (index != last)
+    {
+        heapPlace(index, heap_[last]);
+        heap_.pop_back();
+        // 被换上来的元素可能比父节点小，也可能比孩子大
+        if (index > 0 && heap_[index].when < heap_[(index - 1) / 4].when)
+        {
+            siftUp(index);
+        }
+        else
+        {
+            siftDown(index);
+        }
+    }
+    else
+    {
+        heap_.pop_back();
+    }
+}
+
+void TimerQueue::heapPlace(int index, const Entry& entry)
+{
+    heap_[index] = entry;
+    entry.timer->setHeapIndex(index);
+}
+
+void TimerQueue::siftUp(int index)
+{
+    Entry entry = heap_[index];
+    while (index > 0)
+    {
+        int parent = (index - 1) / 4;
+        if (heap_[parent].when <= entry.when)
+        {
+            break;
+        }
+        heapPlace(index, heap_[parent]);
+        index = parent;
+    }
+    heapPlace(index, entry);
+}
+
+void TimerQueue::siftDown(int index)
+{
+    Entry entry = heap_[index];
+    const int size = static_cast<int>(heap_.size());
+    while (true)
+    {
+        int first = index * 4 + 1;
+        if (first >= size)
+        {
+            break;
+        }
+        int last = first + 4 < size ? first + 4 : size;
+        int smallest = first;
+        for (int child = first + 1; child < last; ++child)
+        {
+            if (heap_[child].when < heap_[smallest].when)
+            {
+                smallest = child;
+            }
+        }
+        if (entry.when <= heap_[smallest].when)
+        {
+            break;
+        }
+        heapPlace(index, heap_[smallest]);
+        index = smallest;
+    }
+    heapPlace(index, entry);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+#include <vector>
+
+class EventLoop;
+class Timer;
+
+/**
+ * 每个EventLoop持有一个TimerQueue
+ * 所有定时器共用一个timerfd，timerfd被包装成一个Channel注册到loop的Poller上，
+ * timerfd总是被设置为最早到期的那个定时器的时间
+ *
+ * 定时器按到期时间组织成一个4叉最小堆(连续的vector)，而不是基于节点的std::set：
+ * 堆的元素里内联保存了到期时间，比较时不需要解引用Timer，10万级别的定时器依然对cache友好
+ *
+ * 失效的Timer不释放，放进freeTimers_留给loop线程里的addTimer复用，直到TimerQueue析构。
+ * TimerId里的Timer指针因此总是有效的，cancel比较一下序号就能判断定时器还在不在，不需要额外的索引表
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop* loop);
+    ~TimerQueue();
+
+    // 线程安全，可以在其他线程调用
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    void cancel(TimerId timerId);
+
+private:
+    struct Entry
+    {
+        int64_t when; // 到期时间(微秒)，和timer->expiration()保持一致
+        Timer* timer;
+    };
+    using TimerHeap = std::vector<Entry>;
+
+    void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读，有定时器到期了
+    void handleRead();
+
+    // 取出所有到期的定时器，放到expired_里
+    void getExpired(Timestamp now);
+    // 重复定时器重新入堆，一次性定时器释放掉
+    void reset(Timestamp now);
+    // 定时器失效，Timer放进freeTimers_
+    void releaseTimer(Timer* timer);
+
+    // 最小堆操作，Timer::heapIndex记录每个定时器在堆中的下标，支持O(logn)删除任意定时器
+    void heapPush(Timer* timer);
+    void heapRemove(int index);
+    void siftUp(int index);
+    void siftDown(int index);
+    void heapPlace(int index, const Entry& entry);
+
+    EventLoop* loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    TimerHeap heap_;
+    std::vector<Timer*> freeTimers_; // 已经失效、等待复用的Timer，只在loop线程里访问
+
+    std::vector<Timer*> expired_; // 本轮到期的定时器，复用内存
+    bool callingExpiredTimers_;
+};
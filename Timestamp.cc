@@ -1,13 +1,16 @@
 #include "Timestamp.h"
 
 #include <time.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <string.h>
 
 Timestamp::Timestamp() : microSecondsSinceEpoch_(0)
 {
 
 }
 
-Timestamp::Timestamp(int64_t microSecondsSinceEpoch) 
+Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
     : microSecondsSinceEpoch_(microSecondsSinceEpoch)
 {
 
@@ -15,20 +18,92 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 
 Timestamp Timestamp::now()
 {
-    //time_t t = time(NULL); return t;  【time_t == long int == int64_t】
-    return Timestamp(time(NULL));
+    // 定时器需要微秒精度，time(NULL)只有秒级
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t seconds = tv.tv_sec;
+    return Timestamp(seconds * kMicroSecondsPerSecond + tv.tv_usec);
+}
+
+Timestamp Timestamp::nowCoarse()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    int64_t seconds = ts.tv_sec;
+    return Timestamp(seconds * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
+namespace
+{
+// 每个线程缓存最近一次格式化的秒数，日志线程每秒只需要调用一次localtime_r
+struct FormatCache
+{
+    int64_t seconds = -1;
+    int len = 0;
+    char buf[32];
+};
+
+thread_local FormatCache t_formatCache;
+}
+
+int Timestamp::formatTo(char* buf, size_t size, bool showMicroseconds) const
+{
+    int64_t seconds = microSecondsSinceEpoch_ / kMicroSecondsPerSecond;
+    int microseconds = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+
+    FormatCache& cache = t_formatCache;
+    if (seconds != cache.seconds)
+    {
+        time_t t = static_cast<time_t>(seconds);
+        struct tm tm_time;
+        localtime_r(&t, &tm_time);
+        cache.len = snprintf(cache.buf, sizeof cache.buf, "%4d/%02d/%02d %02d:%02d:%02d",
+            tm_time.tm_year + 1900,
+            tm_time.tm_mon + 1,
+            tm_time.tm_mday,
+            tm_time.tm_hour,
+            tm_time.tm_min,
+            tm_time.tm_sec);
+        cache.seconds = seconds;
+    }
+
+    // 秒数部分 + ".uuuuuu" + '\0'
+    size_t need = cache.len + (showMicroseconds ? 7 : 0) + 1;
+    if (size < need)
+    {
+        if (size > 0)
+        {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+
+    memcpy(buf, cache.buf, cache.len);
+    int len = cache.len;
+    if (showMicroseconds)
+    {
+        buf[len++] = '.';
+        for (int i = 5; i >= 0; --i)
+        {
+            buf[len + i] = static_cast<char>('0' + microseconds % 10);
+            microseconds /= 10;
+        }
+        len += 6;
+    }
+    buf[len] = '\0';
+    return len;
 }
 
 std::string Timestamp::toString() const
 {
-    char buf[128] = {0};
-    tm* tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-        tm_time->tm_year + 1900,
-        tm_time->tm_mon + 1,
-        tm_time->tm_mday,
-        tm_time->tm_hour,
-        tm_time->tm_min,
-        tm_time->tm_sec);
-    return  buf;
+    char buf[64];
+    int len = formatTo(buf, sizeof buf, false);
+    return std::string(buf, len);
+}
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const
+{
+    char buf[64];
+    int len = formatTo(buf, sizeof buf, showMicroseconds);
+    return std::string(buf, len);
 }
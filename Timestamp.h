@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <stdint.h>
+#include <time.h>
 
 // 时间类
 class Timestamp
@@ -9,7 +11,50 @@ public:
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch); //防止隐式转换
     static Timestamp now();
+    // CLOCK_REALTIME_COARSE走vDSO，不陷入内核，精度是一个jiffy(1~4ms)，适合打日志这种不需要精确时间的场景
+    static Timestamp nowCoarse();
+    static Timestamp invalid() { return Timestamp(); }
+
+    // "2024/01/01 12:00:00"
     std::string toString() const;
+    // "2024/01/01 12:00:00.123456"
+    std::string toFormattedString(bool showMicroseconds = true) const;
+    /**
+     * 把格式化结果写到buf里，返回写入的长度(不含'\0')，不产生任何堆分配
+     * 每个线程缓存上一次格式化的秒数部分，同一秒之内只需要重新渲染微秒后缀
+     */
+    int formatTo(char* buf, size_t size, bool showMicroseconds) const;
+
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const
+    { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 在timestamp的基础上加上seconds秒，得到一个新的时间点(定时器计算到期时间用)
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
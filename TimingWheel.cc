@@ -0,0 +1,149 @@
+#include "TimingWheel.h"
+#include "EventLoop.h"
+
+#include <math.h>
+#include <assert.h>
+
+TimingWheel::Entry::~Entry()
+{
+    if (wheel_)
+    {
+        wheel_->cancel(this);
+    }
+}
+
+static size_t roundUpPowerOfTwo(size_t n)
+{
+    size_t size = 1;
+    while (size < n)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+TimingWheel::TimingWheel(EventLoop* loop, double tickSeconds, size_t numBuckets)
+    : loop_(loop)
+    , tickSeconds_(tickSeconds)
+    , numBuckets_(roundUpPowerOfTwo(numBuckets))
+    , mask_(numBuckets_ - 1)
+    , buckets_(new Entry[numBuckets_])
+    , currentTick_(0)
+    , size_(0)
+    , ticking_(false)
+{}
+
+TimingWheel::~TimingWheel()
+{
+    if (ticking_)
+    {
+        loop_->cancel(tickTimer_);
+    }
+    // 时间轮先于entry析构，把所有entry摘下来，避免entry析构时再访问时间轮
+    for (size_t i = 0; i < numBuckets_; ++i)
+    {
+        Entry* head = &buckets_[i];
+        while (head->next_ != head)
+        {
+            Entry* entry = head->next_;
+            unlink(entry);
+            entry->wheel_ = nullptr;
+        }
+    }
+}
+
+void TimingWheel::link(Entry* head, Entry* entry)
+{
+    entry->prev_ = head->prev_;
+    entry->next_ = head;
+    head->prev_->next_ = entry;
+    head->prev_ = entry;
+}
+
+void TimingWheel::unlink(Entry* entry)
+{
+    entry->prev_->next_ = entry->next_;
+    entry->next_->prev_ = entry->prev_;
+    entry->prev_ = entry;
+    entry->next_ = entry;
+}
+
+void TimingWheel::schedule(Entry* entry, double timeoutSeconds)
+{
+    if (entry->wheel_)
+    {
+        assert(entry->wheel_ == this);
+        unlink(entry);
+        --size_;
+    }
+
+    // 当前这一格已经走了一部分，多算一格，保证实际超时落在[timeout, timeout + tick)之间，不会提前到期
+    uint64_t ticks = static_cast<uint64_t>(ceil(timeoutSeconds / tickSeconds_));
+    entry->timeoutTicks_ = (ticks > 0 ? ticks : 1) + 1;
+    entry->deadline_ = currentTick_ + entry->timeoutTicks_;
+    entry->wheel_ = this;
+    link(&bucketFor(entry->deadline_), entry);
+    ++size_;
+
+    if (!ticking_)
+    {
+        ticking_ = true;
+        tickTimer_ = loop_->runEvery(tickSeconds_, std::bind(&TimingWheel::tick, this));
+    }
+}
+
+void TimingWheel::cancel(Entry* entry)
+{
+    if (entry->wheel_)
+    {
+        assert(entry->wheel_ == this);
+        unlink(entry);
+        entry->wheel_ = nullptr;
+        --size_;
+    }
+}
+
+void TimingWheel::tick()
+{
+    ++currentTick_;
+
+    // 先把当前槽位整条链表摘到pending上，回调里对时间轮的修改(schedule/cancel)都不会影响遍历
+    Entry pending;
+    Entry* head = &bucketFor(currentTick_);
+    if (head->next_ != head)
+    {
+        pending.next_ = head->next_;
+        pending.prev_ = head->prev_;
+        pending.next_->prev_ = &pending;
+        pending.prev_->next_ = &pending;
+        head->next_ = head;
+        head->prev_ = head;
+    }
+
+    while (pending.next_ != &pending)
+    {
+        Entry* entry = pending.next_;
+        unlink(entry);
+        if (entry->deadline_ <= currentTick_)
+        {
+            entry->wheel_ = nullptr;
+            --size_;
+            // 回调里可能会释放entry的持有者，回调之后不能再访问entry
+            if (entry->callback_)
+            {
+                entry->callback_();
+            }
+        }
+        else
+        {
+            // 被touch过或者超时时间超过一圈，挂到它真正到期的槽位上
+            link(&bucketFor(entry->deadline_), entry);
+        }
+    }
+
+    if (size_ == 0 && ticking_)
+    {
+        ticking_ = false;
+        loop_->cancel(tickTimer_);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <stddef.h>
+
+class EventLoop;
+
+/**
+ * 哈希时间轮，给大量的连接空闲超时用(比如100万个连接每个都有一个idle timeout)
+ * 每个EventLoop最多一个，由EventLoop::timingWheel()按需创建，只能在loop所在的线程使用
+ *
+ * TimerQueue的最小堆每次重置都是O(logn)，而空闲超时在每次handleRead时都要重置：
+ *   - schedule/cancel: 侵入式双向链表的插入删除，O(1)，不分配内存
+ *   - touch(重置超时): 只更新Entry的到期tick，O(1)，连链表都不动
+ * 到期tick超出当前槽位的Entry(被touch过，或者超时时间大于一圈)在tick扫到它时再挂到正确的槽位上，
+ * 相当于分层时间轮的降级(cascade)，每个Entry每圈最多被搬一次
+ */
+class TimingWheel : noncopyable
+{
+public:
+    using ExpireCallback = std::function<void()>;
+
+    // 挂在时间轮上的超时项，由使用者持有(比如TcpConnection的成员)，时间轮只保存指针
+    class Entry : noncopyable
+    {
+    public:
+        Entry()
+            : wheel_(nullptr)
+            , prev_(this)
+            , next_(this)
+            , deadline_(0)
+            , timeoutTicks_(0)
+        {}
+        ~Entry();
+
+        void setCallback(ExpireCallback cb) { callback_ = std::move(cb); }
+
+        bool linked() const { return wheel_ != nullptr; }
+
+        // 重置超时时间(重新从现在开始计时)，热路径上调用
+        inline void touch();
+
+    private:
+        friend class TimingWheel;
+
+        TimingWheel* wheel_; // 所在的时间轮，nullptr表示没有挂在时间轮上
+        Entry* prev_;
+        Entry* next_;
+        uint64_t deadline_;     // 到期的tick
+        uint64_t timeoutTicks_; // 超时时长(tick数)
+        ExpireCallback callback_;
+    };
+
+    // tickSeconds: 时间轮的精度  numBuckets: 槽位数量，会向上取整为2的幂
+    TimingWheel(EventLoop* loop, double tickSeconds = 1.0, size_t numBuckets = 512);
+    ~TimingWheel();
+
+    // 把entry挂到时间轮上，timeoutSeconds秒后执行entry的回调，已经挂上的entry会被重新调度
+    void schedule(Entry* entry, double timeoutSeconds);
+    // 从时间轮上摘下entry，回调不会再执行
+    void cancel(Entry* entry);
+
+    // 时间轮走一格，执行所有到期的entry的回调
+    void tick();
+
+    size_t size() const { return size_; }
+    double tickSeconds() const { return tickSeconds_; }
+    uint64_t currentTick() const { return currentTick_; }
+
+private:
+    Entry& bucketFor(uint64_t tick) { return buckets_[tick & mask_]; }
+    static void link(Entry* head, Entry* entry);
+    static void unlink(Entry* entry);
+
+    EventLoop* loop_;
+    const double tickSeconds_;
+    const size_t numBuckets_;
+    const uint64_t mask_;
+    std::unique_ptr<Entry[]> buckets_; // 每个槽位是一个带哨兵的循环双向链表，哨兵就是buckets_[i]本身
+    uint64_t currentTick_;
+    size_t size_;
+
+    bool ticking_;   // 驱动tick的定时器是否已经启动，时间轮上没有entry时不占用loop的定时器
+    TimerId tickTimer_;
+};
+
+inline void TimingWheel::Entry::touch()
+{
+    if (wheel_)
+    {
+        deadline_ = wheel_->currentTick_ + timeoutTicks_;
+    }
+}
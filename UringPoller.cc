@@ -0,0 +1,656 @@
+#include "UringPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <stdlib.h>
+
+// channel的成员index_ = -1
+const int kNew = -1;    // channel未添加到poller中
+const int kAdded = 1;   // channel已添加到poller中
+
+UringPoller::UringPoller(EventLoop* loop)
+    : Poller(loop)
+    , ringFd_(-1)
+    , ring_(MAP_FAILED)
+    , ringSize_(0)
+    , sqes_(static_cast<io_uring_sqe*>(MAP_FAILED))
+    , sqesSize_(0)
+    , sqeTail_(0)
+    , round_(0)
+    , fixedRegion_(nullptr)
+    , inFlightIo_(0)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof params);
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, kEntries, &params));
+    if (fd < 0)
+    {
+        LOG_ERROR("io_uring_setup error:%d \n", errno);
+        return;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG))
+    {
+        LOG_ERROR("io_uring lacks SINGLE_MMAP/EXT_ARG, features:%x \n", params.features);
+        ::close(fd);
+        return;
+    }
+
+    // SQ和CQ共用一块映射
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ringSize_ = sqSize > cqSize ? sqSize : cqSize;
+    ring_ = ::mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (ring_ == MAP_FAILED || sqes_ == MAP_FAILED)
+    {
+        LOG_ERROR("io_uring mmap error:%d \n", errno);
+        ::close(fd);
+        return;
+    }
+
+    char* base = static_cast<char*>(ring_);
+    sqHead_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqeTail_ = *sqTail_;
+    // SQE下标和SQ数组一一对应，之后不再修改数组
+    unsigned* sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries_; ++i)
+    {
+        sqArray[i] = i;
+    }
+
+    cqHead_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    ringFd_ = fd;
+}
+
+UringPoller::~UringPoller()
+{
+    if (ringFd_ >= 0)
+    {
+        drainInFlight();
+    }
+    if (inFlightIo_ == 0)
+    {
+        for (size_t i = kNumFixedBuffers; i < buffers_.size(); ++i)
+        {
+            ::free(buffers_[i].data);
+        }
+        ::free(fixedRegion_);
+    }
+    else
+    {
+        // 内核可能还会往缓冲区里写，宁可泄漏
+        LOG_ERROR("UringPoller::~UringPoller %d requests still in flight, leak io buffers \n", inFlightIo_);
+    }
+    if (sqes_ != MAP_FAILED)
+    {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (ring_ != MAP_FAILED)
+    {
+        ::munmap(ring_, ringSize_);
+    }
+    if (ringFd_ >= 0)
+    {
+        ::close(ringFd_);
+    }
+}
+
+/**
+ * 把本轮积攒的POLL_ADD/POLL_REMOVE和等待合并成一次io_uring_enter
+ * 完成队列里可能同时有多个请求的结果，全部收割后填到activeChannels
+ */
+Timestamp UringPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+    LOG_DEBUG("func[%s] => fd total count: %lu \n", __FUNCTION__, channels_.size());
+
+    ++round_;
+    armPending();
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+
+    struct __kernel_timespec ts;
+    io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof arg);
+    if (timeoutMs >= 0)
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000 * 1000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+
+    int ret = 0;
+    if (!readyList_.empty())
+    {
+        // 有留着的recv结果要交付，只提交不等待
+        ret = toSubmit > 0 ? enter(toSubmit, 0, 0, nullptr, 0) : 0;
+    }
+    else
+    {
+        ret = enter(toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+    }
+    int saveError = errno;
+    Timestamp now(Timestamp::now());
+
+    // ETIME: 超时  EBUSY: 完成队列溢出，先把已有的收割掉
+    if (ret < 0 && saveError != ETIME && saveError != EINTR && saveError != EBUSY)
+    {
+        errno = saveError;
+        LOG_ERROR("UringPoller::poll() err:%d \n", saveError);
+    }
+    fillActiveChannels(activeChannels);
+    deliverHeld(activeChannels);
+    return now;
+}
+
+void UringPoller::updateChannel(Channel* channel)
+{
+    const int index = channel->index();
+    const int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d | events=%d | index =%d \n", __FUNCTION__, fd, channel->events(), index);
+
+    if (index == kNew)
+    {
+        registerChannel(channel);
+    }
+    else
+    {
+        assert(channels_.find(fd) == channel);
+    }
+
+    Slot& s = slot(fd);
+    s.channel = channel;
+    if (channel->isCompletionIo())
+    {
+        // 完成模式没有就绪通知，只需要保证在读的时候有一个recv在内核里
+        if (channel->isReading())
+        {
+            if (s.recvHeld)
+            {
+                scheduleReady(fd);
+            }
+            else if (!s.recvArmed)
+            {
+                scheduleArm(fd);
+            }
+        }
+        return;
+    }
+    if (s.armed)
+    {
+        if (s.armedEvents == channel->events())
+        {
+            countUpdateSkipped();
+            return;
+        }
+        cancelPoll(fd, s); // 关注的事件变了，撤掉旧的poll再按新的掩码提交
+    }
+    if (!channel->isNoneEvent())
+    {
+        scheduleArm(fd);
+    }
+}
+
+void UringPoller::removeChannel(Channel* channel)
+{
+    int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d \n", __FUNCTION__, fd);
+
+    assert(channels_.find(fd) == channel);
+    assert(channel->isNoneEvent());
+
+    channels_.erase(fd);
+
+    Slot& s = slot(fd);
+    if (s.armed)
+    {
+        cancelPoll(fd, s);
+    }
+    // 在途的recv/send撤销掉，缓冲区等完成事件回来再归还；不在途的直接归还
+    if (s.recvArmed)
+    {
+        cancelIo(makeUserData(fd, kRecvOp, s.generation), s.recvBuf);
+    }
+    else if (s.recvBuf >= 0)
+    {
+        freeBuffer(s.recvBuf);
+    }
+    if (s.sendArmed)
+    {
+        cancelIo(makeUserData(fd, kSendOp, s.generation), s.sendBuf);
+    }
+    else if (s.sendBuf >= 0)
+    {
+        freeBuffer(s.sendBuf);
+    }
+    s.recvBuf = -1;
+    s.sendBuf = -1;
+    s.recvArmed = false;
+    s.sendArmed = false;
+    s.recvHeld = false;
+
+    s.channel = nullptr;
+    ++s.generation; // 之后这个fd上旧请求的完成事件全部作废
+    channel->set_index(kNew);
+}
+
+// 发送可能发生在channel第一次提交关注事件之前(比如在连接回调里send)，这时也要登记，保证移除时会撤销在途的send
+void UringPoller::registerChannel(Channel* channel)
+{
+    int fd = channel->fd();
+    assert(channels_.find(fd) == nullptr);
+    channels_.insert(fd, channel);
+    channel->set_index(kAdded);
+}
+
+char* UringPoller::sendBuffer(Channel* channel, size_t* size)
+{
+    int fd = channel->fd();
+    if (channel->index() == kNew)
+    {
+        registerChannel(channel);
+    }
+    Slot& s = slot(fd);
+    s.channel = channel;
+    assert(!s.sendArmed);
+    if (s.sendBuf < 0)
+    {
+        s.sendBuf = allocBuffer();
+    }
+    *size = kIoBufferSize;
+    return buffers_[s.sendBuf].data;
+}
+
+void UringPoller::submitSend(Channel* channel, size_t len)
+{
+    int fd = channel->fd();
+    Slot& s = slots_[fd];
+    assert(s.channel == channel && s.sendBuf >= 0 && !s.sendArmed);
+    assert(len <= kIoBufferSize);
+    submitIo(fd, s, kSendOp, s.sendBuf, len);
+    s.sendArmed = true;
+}
+
+UringPoller::Slot& UringPoller::slot(int fd)
+{
+    size_t need = static_cast<size_t>(fd) + 1;
+    if (need > slots_.size())
+    {
+        slots_.resize(need > 2 * slots_.size() ? need : 2 * slots_.size());
+    }
+    return slots_[fd];
+}
+
+void UringPoller::scheduleArm(int fd)
+{
+    Slot& s = slots_[fd];
+    if (!s.needArm)
+    {
+        s.needArm = true;
+        armList_.push_back(fd);
+    }
+}
+
+void UringPoller::scheduleReady(int fd)
+{
+    Slot& s = slots_[fd];
+    if (!s.needReady)
+    {
+        s.needReady = true;
+        readyList_.push_back(fd);
+    }
+}
+
+void UringPoller::armPending()
+{
+    for (int fd : armList_)
+    {
+        Slot& s = slots_[fd];
+        s.needArm = false;
+        if (s.channel && s.channel->isCompletionIo())
+        {
+            if (s.channel->isReading() && !s.recvArmed && !s.recvHeld)
+            {
+                submitRecv(fd, s);
+            }
+        }
+        else if (s.channel && !s.armed && !s.channel->isNoneEvent())
+        {
+            submitPoll(fd, s);
+        }
+    }
+    armList_.clear();
+}
+
+void UringPoller::submitPoll(int fd, Slot& s)
+{
+    io_uring_sqe* sqe = getSqe();
+    int events = s.channel->events();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    // EPOLLIN/EPOLLOUT/EPOLLPRI/EPOLLRDHUP和poll的掩码数值相同，EPOLLET不是poll的标志
+    sqe->poll32_events = static_cast<uint32_t>(events & ~EPOLLET);
+    if (s.channel->isEdgeTriggered())
+    {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    sqe->user_data = makeUserData(fd, kPollOp, s.generation);
+
+    s.armed = true;
+    s.armedEvents = events;
+    countUpdate();
+}
+
+void UringPoller::cancelPoll(int fd, Slot& s)
+{
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, kPollOp, s.generation);
+    sqe->user_data = kCancelTag;
+
+    s.armed = false;
+    ++s.generation;
+    countUpdate();
+}
+
+void UringPoller::submitRecv(int fd, Slot& s)
+{
+    if (s.recvBuf < 0)
+    {
+        s.recvBuf = allocBuffer();
+    }
+    submitIo(fd, s, kRecvOp, s.recvBuf, kIoBufferSize);
+    s.recvArmed = true;
+}
+
+// 注册过的缓冲区用READ_FIXED/WRITE_FIXED，内核不用每次都去pin用户内存
+void UringPoller::submitIo(int fd, Slot& s, OpKind kind, int buffer, size_t len)
+{
+    const IoBuffer& buf = buffers_[buffer];
+    io_uring_sqe* sqe = getSqe();
+    if (kind == kRecvOp)
+    {
+        sqe->opcode = buf.fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    }
+    else
+    {
+        sqe->opcode = buf.fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    }
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf.data);
+    sqe->len = static_cast<uint32_t>(len);
+    sqe->off = 0; // socket不能seek，偏移必须是0
+    if (buf.fixed)
+    {
+        sqe->buf_index = static_cast<uint16_t>(buffer);
+    }
+    sqe->user_data = makeUserData(fd, kind, s.generation);
+    ++inFlightIo_;
+}
+
+void UringPoller::cancelIo(uint64_t userData, int buffer)
+{
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = userData;
+    sqe->user_data = kCancelTag;
+    orphans_.push_back(Orphan{userData, buffer});
+}
+
+void UringPoller::releaseOrphan(uint64_t userData)
+{
+    for (size_t i = 0; i < orphans_.size(); ++i)
+    {
+        if (orphans_[i].userData == userData)
+        {
+            freeBuffer(orphans_[i].buffer);
+            orphans_[i] = orphans_.back();
+            orphans_.pop_back();
+            return;
+        }
+    }
+}
+
+/**
+ * 第一次使用时分配kNumFixedBuffers个缓冲区并注册到ring(IORING_REGISTER_BUFFERS)，
+ * 注册失败(比如RLIMIT_MEMLOCK太小)时照常使用，只是改用普通的READ/WRITE；
+ * 都用完以后再malloc的缓冲区不注册，用完了放回空闲列表继续复用
+ */
+int UringPoller::allocBuffer()
+{
+    if (buffers_.empty())
+    {
+        fixedRegion_ = static_cast<char*>(::malloc(kNumFixedBuffers * kIoBufferSize));
+        if (fixedRegion_ == nullptr)
+        {
+            LOG_FATAL("UringPoller::allocBuffer malloc error \n");
+        }
+        std::vector<struct iovec> iovs(kNumFixedBuffers);
+        for (int i = 0; i < kNumFixedBuffers; ++i)
+        {
+            iovs[i].iov_base = fixedRegion_ + i * kIoBufferSize;
+            iovs[i].iov_len = kIoBufferSize;
+        }
+        countSyscall();
+        bool fixed = ::syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_BUFFERS, iovs.data(), kNumFixedBuffers) == 0;
+        if (!fixed)
+        {
+            LOG_ERROR("io_uring register buffers error:%d, use unregistered buffers \n", errno);
+        }
+        // 下标i对应注册时的第i个iovec(buf_index)
+        for (int i = 0; i < kNumFixedBuffers; ++i)
+        {
+            buffers_.push_back(IoBuffer{fixedRegion_ + i * kIoBufferSize, fixed});
+        }
+        for (int i = kNumFixedBuffers - 1; i >= 0; --i)
+        {
+            freeBuffers_.push_back(i);
+        }
+    }
+
+    if (freeBuffers_.empty())
+    {
+        char* data = static_cast<char*>(::malloc(kIoBufferSize));
+        if (data == nullptr)
+        {
+            LOG_FATAL("UringPoller::allocBuffer malloc error \n");
+        }
+        buffers_.push_back(IoBuffer{data, false});
+        return static_cast<int>(buffers_.size() - 1);
+    }
+    int buffer = freeBuffers_.back();
+    freeBuffers_.pop_back();
+    return buffer;
+}
+
+void UringPoller::freeBuffer(int buffer)
+{
+    freeBuffers_.push_back(buffer);
+}
+
+// 析构前把撤销请求提交掉，等在途的recv/send都结束(最多等1秒)，之后才能释放缓冲区
+void UringPoller::drainInFlight()
+{
+    for (int i = 0; i < 10 && inFlightIo_ > 0; ++i)
+    {
+        __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+        unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+
+        struct __kernel_timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = 100 * 1000 * 1000;
+        io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof arg);
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        enter(toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+
+        // 这时channel可能已经析构了，只清点recv/send，不碰channel
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            if (cqe.user_data != kCancelTag && ((cqe.user_data >> 30) & 3) != kPollOp)
+            {
+                --inFlightIo_;
+            }
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+}
+
+// 提交队列满了就先把已有的提交给内核(不等待)
+io_uring_sqe* UringPoller::getSqe()
+{
+    if (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+    {
+        __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+        unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (enter(toSubmit, 0, 0, nullptr, 0) < 0)
+        {
+            LOG_FATAL("io_uring_enter submit error:%d \n", errno);
+        }
+    }
+    io_uring_sqe* sqe = &sqes_[sqeTail_ & sqMask_];
+    ++sqeTail_;
+    memset(sqe, 0, sizeof *sqe);
+    return sqe;
+}
+
+int UringPoller::enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize)
+{
+    countSyscall();
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete, flags, arg, argSize));
+}
+
+void UringPoller::fillActiveChannels(ChannelList* activeChannels)
+{
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const io_uring_cqe& cqe = cqes_[head & cqMask_];
+        if (cqe.user_data == kCancelTag)
+        {
+            continue;
+        }
+
+        int fd = static_cast<int>(cqe.user_data >> 32);
+        OpKind kind = static_cast<OpKind>((cqe.user_data >> 30) & 3);
+        uint32_t generation = static_cast<uint32_t>(cqe.user_data) & kGenerationMask;
+        if (kind != kPollOp)
+        {
+            --inFlightIo_;
+        }
+        if (static_cast<size_t>(fd) >= slots_.size())
+        {
+            continue;
+        }
+        Slot& s = slots_[fd];
+        if ((s.generation & kGenerationMask) != generation || s.channel == nullptr)
+        {
+            if (kind != kPollOp)
+            {
+                releaseOrphan(cqe.user_data);
+            }
+            continue; // 已经被撤销或者fd已经换了主人
+        }
+
+        if (kind == kRecvOp)
+        {
+            s.recvArmed = false;
+            if (s.channel->isReading())
+            {
+                s.channel->set_recvResult(buffers_[s.recvBuf].data, cqe.res);
+                addActive(s, EPOLLIN, activeChannels);
+                scheduleArm(fd);
+            }
+            else
+            {
+                s.recvHeld = true;
+                s.recvRes = cqe.res;
+            }
+            continue;
+        }
+        if (kind == kSendOp)
+        {
+            // 数据已经交给内核(或者出错)，发送缓冲区不再需要，下一次发送再分配
+            s.sendArmed = false;
+            freeBuffer(s.sendBuf);
+            s.sendBuf = -1;
+            s.channel->set_sendResult(cqe.res);
+            addActive(s, EPOLLOUT, activeChannels);
+            continue;
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE))
+        {
+            // 一次性的poll完成了(或者内核结束了多次触发的poll)，下一次poll之前重新提交
+            s.armed = false;
+            scheduleArm(fd);
+        }
+        if (cqe.res < 0)
+        {
+            if (cqe.res != -ECANCELED)
+            {
+                LOG_ERROR("io_uring poll fd=%d err:%d \n", fd, -cqe.res);
+            }
+            continue;
+        }
+
+        addActive(s, cqe.res, activeChannels);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+// 一轮里同一个channel可能有多个完成事件(多次触发的poll，或者recv和send同时完成)，合并成一次
+void UringPoller::addActive(Slot& s, int revents, ChannelList* activeChannels)
+{
+    Channel* channel = s.channel;
+    if (s.activeRound == round_)
+    {
+        channel->set_revents(channel->revents() | revents);
+    }
+    else
+    {
+        s.activeRound = round_;
+        channel->set_revents(revents);
+        activeChannels->push_back(channel);
+    }
+}
+
+// 交付channel不读期间完成的recv
+void UringPoller::deliverHeld(ChannelList* activeChannels)
+{
+    for (int fd : readyList_)
+    {
+        Slot& s = slots_[fd];
+        s.needReady = false;
+        if (s.channel && s.recvHeld && s.channel->isReading())
+        {
+            s.recvHeld = false;
+            s.channel->set_recvResult(buffers_[s.recvBuf].data, s.recvRes);
+            addActive(s, EPOLLIN, activeChannels);
+            scheduleArm(fd);
+        }
+    }
+    readyList_.clear();
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <vector>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+class Channel;
+
+/**
+ * 基于io_uring的就绪通知(readiness)后端，和EPollPoller遵守同样的Poller/Channel约定
+ * 直接使用io_uring_setup/io_uring_enter系统调用，不依赖liburing
+ *
+ * 水平触发的channel: 一次性IORING_OP_POLL_ADD，完成后在下一次poll之前重新提交，
+ *                   fd仍然就绪时会立刻再次完成，效果和LT一样
+ * 边沿触发的channel: 多次触发的poll(IORING_POLL_ADD_MULTI)，只有在内核结束它时才重新提交
+ *
+ * 一轮loop里所有的提交(POLL_ADD/POLL_REMOVE)和等待合并成一次io_uring_enter
+ * 需要内核支持IORING_FEAT_EXT_ARG(5.11+)，不支持时valid()返回false，由newDefaultPoller退回epoll
+ *
+ * 完成模式(Channel::setCompletionIo，TcpServer::setCompletionIo打开)：
+ * - 在读的channel一直有一个READ_FIXED在内核里，数据直接收进注册过的缓冲区，完成后交给channel，下一轮重新提交
+ * - 发送由channel把数据拷贝进注册缓冲区后提交WRITE_FIXED(sendBuffer/submitSend)，完成后把结果交给channel
+ * - 收发都和等待合并在同一次io_uring_enter里，不再有每次操作的read/write系统调用
+ * - 注册缓冲区一共kNumFixedBuffers个，第一次使用时分配并注册，用完以后临时malloc的缓冲区改用普通READ/WRITE
+ * - 每个在读的连接固定占用一个kIoBufferSize的接收缓冲区，发送缓冲区只在发送期间占用
+ * - channel不读的时候在途的recv不撤销，完成的结果先留着，重新enableReading时再交付，数据不会丢
+ * - channel移除时撤销(ASYNC_CANCEL)在途的请求，缓冲区等完成事件回来以后才回收
+ */
+class UringPoller : public Poller
+{
+public:
+    UringPoller(EventLoop* loop); // io_uring_setup + mmap
+    ~UringPoller() override;
+
+    // 初始化是否成功
+    bool valid() const { return ringFd_ >= 0; }
+
+    // 重写基类Poller的抽象方法
+    Timestamp poll(int timeoutMs, ChannelList* activeChannels) override; // io_uring_enter
+    void updateChannel(Channel* channel) override; // 准备POLL_ADD/POLL_REMOVE
+    void removeChannel(Channel* channel) override;
+
+    bool supportsCompletionIo() const override { return true; }
+    char* sendBuffer(Channel* channel, size_t* size) override;
+    void submitSend(Channel* channel, size_t len) override; // WRITE_FIXED
+
+private:
+    static const unsigned kEntries = 1024;
+    static const uint64_t kCancelTag = ~0ULL; // POLL_REMOVE/ASYNC_CANCEL自己的完成事件直接忽略
+    static const size_t kIoBufferSize = 16 * 1024;
+    static const int kNumFixedBuffers = 256;
+
+    // user_data = fd << 32 | 请求类型 << 30 | generation(低30位)，generation变了以后旧请求的完成事件就是过期的
+    enum OpKind { kPollOp = 0, kRecvOp = 1, kSendOp = 2 };
+    static const uint32_t kGenerationMask = (1u << 30) - 1;
+
+    // 每个fd一个槽位
+    struct Slot
+    {
+        Channel* channel = nullptr;
+        uint32_t generation = 0;
+        int armedEvents = 0;  // 内核中正在等待的poll掩码
+        bool armed = false;
+        bool needArm = false; // 已经在armList_里
+        uint64_t activeRound = 0;
+
+        // 完成模式
+        int recvBuf = -1;       // 接收缓冲区在buffers_里的下标
+        int sendBuf = -1;
+        bool recvArmed = false; // 请求在内核里
+        bool sendArmed = false;
+        bool recvHeld = false;  // recv完成时channel没在读，结果留到重新enableReading
+        bool needReady = false; // 已经在readyList_里
+        int recvRes = 0;
+    };
+
+    struct IoBuffer
+    {
+        char* data;
+        bool fixed; // 注册过，可以用READ_FIXED/WRITE_FIXED
+    };
+
+    // 已经撤销、完成事件还没回来的请求，完成事件回来时归还它的缓冲区
+    struct Orphan
+    {
+        uint64_t userData;
+        int buffer;
+    };
+
+    static uint64_t makeUserData(int fd, OpKind kind, uint32_t generation)
+    {
+        return (static_cast<uint64_t>(fd) << 32) | (static_cast<uint64_t>(kind) << 30) | (generation & kGenerationMask);
+    }
+
+    Slot& slot(int fd);
+    void registerChannel(Channel* channel);
+    void scheduleArm(int fd);
+    void scheduleReady(int fd);
+    void armPending();
+    void submitPoll(int fd, Slot& slot);
+    void cancelPoll(int fd, Slot& slot);
+    void submitRecv(int fd, Slot& slot);
+    void submitIo(int fd, Slot& slot, OpKind kind, int buffer, size_t len);
+    void cancelIo(uint64_t userData, int buffer);
+    int allocBuffer();
+    void freeBuffer(int buffer);
+    void releaseOrphan(uint64_t userData);
+    void drainInFlight();
+    io_uring_sqe* getSqe();
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize);
+    void fillActiveChannels(ChannelList* activeChannels);
+    void deliverHeld(ChannelList* activeChannels);
+    void addActive(Slot& slot, int revents, ChannelList* activeChannels);
+
+    int ringFd_;
+    void* ring_;
+    size_t ringSize_;
+    io_uring_sqe* sqes_;
+    size_t sqesSize_;
+
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned sqeTail_; // 本地的提交队列尾，poll之前才发布给内核
+
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    io_uring_cqe* cqes_;
+
+    std::vector<Slot> slots_;
+    std::vector<int> armList_; // 下一次poll之前需要重新提交POLL_ADD/recv的fd
+    std::vector<int> readyList_; // 留着的recv结果可以交付了的fd，poll不再阻塞
+    uint64_t round_;
+
+    std::vector<IoBuffer> buffers_; // 前kNumFixedBuffers个在fixedRegion_里
+    std::vector<int> freeBuffers_;
+    char* fixedRegion_;
+    std::vector<Orphan> orphans_;
+    int inFlightIo_; // 内核里的recv/send请求个数，析构时要等它们结束才能释放缓冲区
+};
@@ -0,0 +1,65 @@
+#include <mymuduo/Logger.h>
+#include <mymuduo/AsyncLogging.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+/**
+ * 日志吞吐量对比：默认的同步Logger(写stdout) vs AsyncLogging(后台线程写滚动文件)
+ * 用法: ./asynclogging_bench [numThreads] [linesPerThread] > /dev/null
+ * 结果输出到stderr，stdout是同步Logger的输出目的地，可以重定向到文件或者/dev/null
+ */
+
+static AsyncLogging* g_asyncLog = nullptr;
+
+static void asyncOutput(const char* msg, size_t len)
+{
+    g_asyncLog->append(msg, len);
+}
+
+static double run(int numThreads, int linesPerThread)
+{
+    Timestamp start(Timestamp::now());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([t, linesPerThread]() {
+            for (int i = 0; i < linesPerThread; ++i)
+            {
+                LOG_INFO("thread %d line %d: abcdefghijklmnopqrstuvwxyz 0123456789", t, i);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    Timestamp end(Timestamp::now());
+    double seconds = static_cast<double>(end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch())
+                     / Timestamp::kMicroSecondsPerSecond;
+    return numThreads * linesPerThread / seconds;
+}
+
+int main(int argc, char* argv[])
+{
+    int numThreads = argc > 1 ? atoi(argv[1]) : 4;
+    int linesPerThread = argc > 2 ? atoi(argv[2]) : 250000;
+
+    double syncRate = run(numThreads, linesPerThread);
+    fprintf(stderr, "sync  Logger -> stdout     : %10.0f lines/sec\n", syncRate);
+
+    AsyncLogging asyncLog("/tmp/asynclogging_bench", 500 * 1024 * 1024);
+    g_asyncLog = &asyncLog;
+    asyncLog.start();
+    Logger::setOutput(asyncOutput);
+
+    double asyncRate = run(numThreads, linesPerThread);
+    asyncLog.stop();
+    fprintf(stderr, "async Logger -> rolling file: %10.0f lines/sec (dropped %lu)\n",
+        asyncRate, static_cast<unsigned long>(asyncLog.droppedLines()));
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Buffer.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/**
+ * Buffer扩容/缩小基准测试(在EventLoop线程里运行，存储来自SlabAllocator)
+ *   append:  不retrieve，按chunk字节连续append到total字节，统计平均耗时和重新分配的次数
+ *   exact:   同append，但模拟原来的按需精确扩容(可写空间不够时换一块刚好放下的存储)
+ *   stream:  每次append一个chunk、retrieve一个chunk，始终留下1字节，测试先挪数据再扩容
+ *   partial: 模拟每次读到64KB/256KB(ET一次回调的预算)，处理完留下50字节的半个消息再releaseMemory，
+ *            统计每次读平均的重新分配次数(缩小没有迟滞时每次读都会缩小再扩容)
+ *   burst:   一次性append 64MB，读走只剩100字节后releaseMemory，看容量是否还回去
+ * 用法: ./buffer_bench [chunk] [totalMB]
+ */
+
+static double elapsedNs(Timestamp start, Timestamp end, size_t ops)
+{
+    return (end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) * 1000.0 / ops;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t chunk = argc > 1 ? atol(argv[1]) : 1024;
+    size_t total = (argc > 2 ? atol(argv[2]) : 4) * 1024 * 1024;
+
+    EventLoop loop;
+    std::vector<char> data(chunk, 'x');
+
+    {
+        Buffer buf;
+        size_t reallocations = 0;
+        size_t capacity = buf.capacity();
+        size_t ops = total / chunk;
+        Timestamp start(Timestamp::now());
+        for (size_t i = 0; i < ops; ++i)
+        {
+            buf.append(data.data(), chunk);
+            if (buf.capacity() != capacity)
+            {
+                capacity = buf.capacity();
+                ++reallocations;
+            }
+        }
+        Timestamp end(Timestamp::now());
+        printf("append  %zu x %zu bytes: %.1f ns/op  %zu reallocations  capacity %zu\n",
+            ops, chunk, elapsedNs(start, end, ops), reallocations, buf.capacity());
+    }
+
+    {
+        Buffer buf;
+        size_t reallocations = 0;
+        size_t capacity = buf.capacity();
+        size_t ops = total / chunk;
+        Timestamp start(Timestamp::now());
+        for (size_t i = 0; i < ops; ++i)
+        {
+            if (buf.writableBytes() < chunk)
+            {
+                // 原来的resize(writerIndex_ + len)：只扩到刚好放下，每次都把已有数据拷贝一遍
+                Buffer grown(buf.readableBytes() + chunk);
+                grown.append(buf.peek(), buf.readableBytes());
+                buf.swap(grown);
+            }
+            buf.append(data.data(), chunk);
+            if (buf.capacity() != capacity)
+            {
+                capacity = buf.capacity();
+                ++reallocations;
+            }
+        }
+        Timestamp end(Timestamp::now());
+        printf("exact   %zu x %zu bytes: %.1f ns/op  %zu reallocations  capacity %zu\n",
+            ops, chunk, elapsedNs(start, end, ops), reallocations, buf.capacity());
+    }
+
+    {
+        Buffer buf;
+        buf.append(data.data(), 1);
+        size_t ops = total / chunk;
+        Timestamp start(Timestamp::now());
+        for (size_t i = 0; i < ops; ++i)
+        {
+            buf.append(data.data(), chunk);
+            buf.retrieve(chunk);
+        }
+        Timestamp end(Timestamp::now());
+        printf("stream  %zu x %zu bytes: %.1f ns/op  capacity %zu\n",
+            ops, chunk, elapsedNs(start, end, ops), buf.capacity());
+    }
+
+    for (size_t readSize : {64 * 1024, 256 * 1024})
+    {
+        Buffer buf(0);
+        std::vector<char> input(readSize, 'z');
+        size_t reallocations = 0;
+        size_t capacity = buf.capacity();
+        const size_t reads = 10000;
+        for (size_t i = 0; i < reads; ++i)
+        {
+            buf.append(input.data(), input.size());
+            if (buf.capacity() != capacity)
+            {
+                capacity = buf.capacity();
+                ++reallocations;
+            }
+            buf.retrieve(buf.readableBytes() - 50);
+            buf.releaseMemory();
+            if (buf.capacity() != capacity)
+            {
+                capacity = buf.capacity();
+                ++reallocations;
+            }
+        }
+        printf("partial %zu reads of %zu bytes: %.3f reallocations/read  capacity %zu\n",
+            reads, readSize, static_cast<double>(reallocations) / reads, buf.capacity());
+    }
+
+    {
+        Buffer buf;
+        std::vector<char> burst(64 * 1024 * 1024, 'y');
+        buf.append(burst.data(), burst.size());
+        size_t peak = buf.capacity();
+        buf.retrieve(burst.size() - 100);
+        buf.releaseMemory();
+        printf("burst   64MB: capacity %zu -> %zu after releaseMemory with %zu bytes left\n",
+            peak, buf.capacity(), buf.readableBytes());
+    }
+    return 0;
+}
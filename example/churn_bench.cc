@@ -0,0 +1,151 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+#include <mymuduo/SlabAllocator.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+/**
+ * 连接建立/断开的吞吐：客户端线程反复connect、等服务端建立连接、close、等服务端断开
+ * 输出每秒完成的连接数，服务端平均每个连接的堆分配次数(替换全局operator new统计，不含SlabAllocator内部的malloc)，
+ * 以及subloop上SlabAllocator的分配次数和其中复用空闲块(省掉malloc)的次数
+ * 用法: ./churn_bench [connections] [threads]
+ */
+
+static const uint16_t kPort = 9992;
+
+static std::atomic<uint64_t> numAllocs(0);
+static std::atomic<int> numConnected(0);
+static std::atomic<int> numDisconnected(0);
+
+void* operator new(size_t size)
+{
+    numAllocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+static int connectServer()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+static void waitFor(std::atomic<int>& counter, int expected)
+{
+    while (counter.load() < expected)
+    {
+        sched_yield();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int numConns = argc > 1 ? atoi(argv[1]) : 20000;
+    int threads = argc > 2 ? atoi(argv[2]) : 1;
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "ChurnBench");
+    server.setThreadNum(threads);
+    std::mutex mutex;
+    std::vector<EventLoop*> loops;
+    server.setThreadInitCallback([&](EventLoop* ioLoop) {
+        std::lock_guard<std::mutex> lock(mutex);
+        loops.push_back(ioLoop);
+    });
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            ++numConnected;
+        }
+        else
+        {
+            ++numDisconnected;
+        }
+    });
+    server.start();
+
+    std::thread client([&]() {
+        // 预热，让fd表、连接表等容器先长到稳定的大小
+        int warmup = 1000;
+        for (int i = 0; i < warmup; ++i)
+        {
+            int fd = connectServer();
+            waitFor(numConnected, i + 1);
+            ::close(fd);
+            waitFor(numDisconnected, i + 1);
+        }
+
+        auto slabStats = [&](uint64_t* allocations, uint64_t* reused) {
+            *allocations = 0;
+            *reused = 0;
+            for (EventLoop* ioLoop : loops)
+            {
+                *allocations += ioLoop->slabAllocator()->numAllocations();
+                *reused += ioLoop->slabAllocator()->numReused();
+            }
+        };
+        uint64_t slabAllocsBefore, slabReusedBefore;
+        slabStats(&slabAllocsBefore, &slabReusedBefore);
+        uint64_t allocsBefore = numAllocs.load();
+        Timestamp start(Timestamp::now());
+        for (int i = 0; i < numConns; ++i)
+        {
+            int fd = connectServer();
+            waitFor(numConnected, warmup + i + 1);
+            ::close(fd);
+            waitFor(numDisconnected, warmup + i + 1);
+        }
+        double elapsed = timeDifference(Timestamp::now(), start);
+        uint64_t allocs = numAllocs.load() - allocsBefore;
+        uint64_t slabAllocs, slabReused;
+        slabStats(&slabAllocs, &slabReused);
+
+        printf("connections %d  %.0f conn/s  %.1f allocations/conn  slab %.1f allocations/conn (%.1f reused)\n",
+            numConns, numConns / elapsed, static_cast<double>(allocs) / numConns,
+            static_cast<double>(slabAllocs - slabAllocsBefore) / numConns,
+            static_cast<double>(slabReused - slabReusedBefore) / numConns);
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Buffer.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <string>
+
+/**
+ * 协议解析基准测试(在EventLoop线程里运行)
+ *   frame:  解析[int32长度][消息体]格式的消息
+ *           manual: memcpy + ntohl，再retrieveAsString拷贝出消息体
+ *           typed:  readInt32，直接在Buffer里处理消息体，不做中间拷贝
+ *   encode: 组装[int32长度][消息体]
+ *           manual: 先拼一个std::string再append
+ *           typed:  先append消息体，再prependInt32写长度头
+ *   line:   按"\r\n"切分文本行，std::search逐字节比较 vs findCRLF(memchr)
+ * 用法: ./codec_bench [payloadBytes] [messages]
+ */
+
+static double elapsedNs(Timestamp start, Timestamp end, size_t ops)
+{
+    return (end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) * 1000.0 / ops;
+}
+
+static const char kCRLF[] = "\r\n";
+
+int main(int argc, char* argv[])
+{
+    size_t payload = argc > 1 ? atol(argv[1]) : 64;
+    size_t messages = argc > 2 ? atol(argv[2]) : 1000000;
+
+    EventLoop loop;
+    std::string body(payload, 'x');
+    uint64_t checksum = 0;
+
+    Buffer frames;
+    for (size_t i = 0; i < messages; ++i)
+    {
+        frames.appendInt32(static_cast<int32_t>(body.size()));
+        frames.append(body.data(), body.size());
+    }
+
+    {
+        Buffer buf(frames);
+        Timestamp start(Timestamp::now());
+        while (buf.readableBytes() >= sizeof(int32_t))
+        {
+            uint32_t be;
+            memcpy(&be, buf.peek(), sizeof be);
+            size_t len = ntohl(be);
+            buf.retrieve(sizeof be);
+            std::string msg = buf.retrieveAsString(len);
+            checksum += static_cast<unsigned char>(msg[len / 2]);
+        }
+        Timestamp end(Timestamp::now());
+        printf("frame  manual  %zu x %zu bytes: %.1f ns/msg\n", messages, payload, elapsedNs(start, end, messages));
+    }
+
+    {
+        Buffer buf(frames);
+        Timestamp start(Timestamp::now());
+        while (buf.readableBytes() >= sizeof(int32_t))
+        {
+            size_t len = buf.readInt32();
+            checksum += static_cast<unsigned char>(buf.peek()[len / 2]);
+            buf.retrieve(len);
+        }
+        Timestamp end(Timestamp::now());
+        printf("frame  typed   %zu x %zu bytes: %.1f ns/msg\n", messages, payload, elapsedNs(start, end, messages));
+    }
+
+    {
+        Buffer out;
+        Timestamp start(Timestamp::now());
+        for (size_t i = 0; i < messages; ++i)
+        {
+            uint32_t be = htonl(static_cast<uint32_t>(body.size()));
+            std::string frame(reinterpret_cast<const char*>(&be), sizeof be);
+            frame += body;
+            out.append(frame.data(), frame.size());
+            out.retrieveAll();
+        }
+        Timestamp end(Timestamp::now());
+        printf("encode manual  %zu x %zu bytes: %.1f ns/msg\n", messages, payload, elapsedNs(start, end, messages));
+    }
+
+    {
+        Buffer out;
+        Timestamp start(Timestamp::now());
+        for (size_t i = 0; i < messages; ++i)
+        {
+            out.append(body.data(), body.size());
+            out.prependInt32(static_cast<int32_t>(body.size()));
+            checksum += out.readableBytes();
+            out.retrieveAll();
+        }
+        Timestamp end(Timestamp::now());
+        printf("encode typed   %zu x %zu bytes: %.1f ns/msg\n", messages, payload, elapsedNs(start, end, messages));
+    }
+
+    Buffer lines;
+    for (size_t i = 0; i < messages; ++i)
+    {
+        lines.append(body.data(), body.size());
+        lines.append(kCRLF, 2);
+    }
+
+    {
+        Buffer buf(lines);
+        Timestamp start(Timestamp::now());
+        while (buf.readableBytes() > 0)
+        {
+            const char* end = buf.peek() + buf.readableBytes();
+            const char* crlf = std::search(buf.peek(), end, kCRLF, kCRLF + 2);
+            if (crlf == end)
+            {
+                break;
+            }
+            checksum += crlf - buf.peek();
+            buf.retrieveUntil(crlf + 2);
+        }
+        Timestamp end(Timestamp::now());
+        printf("line   search  %zu x %zu bytes: %.1f ns/line\n", messages, payload, elapsedNs(start, end, messages));
+    }
+
+    {
+        Buffer buf(lines);
+        Timestamp start(Timestamp::now());
+        while (const char* crlf = buf.findCRLF())
+        {
+            checksum += crlf - buf.peek();
+            buf.retrieveUntil(crlf + 2);
+        }
+        Timestamp end(Timestamp::now());
+        printf("line   memchr  %zu x %zu bytes: %.1f ns/line\n", messages, payload, elapsedNs(start, end, messages));
+    }
+
+    printf("checksum %lu\n", (unsigned long)checksum);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * 空闲连接的内存占用：建立n个连接，每个连接echo一条小消息以后保持空闲
+ * 输出建立连接前后进程RSS的差值除以连接数(包含客户端这一侧的少量用户态内存)
+ * 用法: ./idle_bench [connections]
+ */
+
+static const uint16_t kPort = 9993;
+
+static std::atomic<int> numConnected(0);
+
+static long rssKb()
+{
+    long pages = 0, resident = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp)
+    {
+        if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(fp);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static int connectServer()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[])
+{
+    int numConns = argc > 1 ? atoi(argv[1]) : 8000;
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "IdleBench");
+    server.setThreadNum(1);
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            ++numConnected;
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+
+    std::thread client([&]() {
+        std::vector<int> fds;
+        fds.reserve(numConns);
+        usleep(100 * 1000);
+        long before = rssKb();
+        for (int i = 0; i < numConns; ++i)
+        {
+            int fd = connectServer();
+            char buf[16] = "hello";
+            if (::write(fd, buf, 5) != 5 || ::read(fd, buf, sizeof buf) <= 0)
+            {
+                perror("echo");
+                exit(1);
+            }
+            fds.push_back(fd);
+        }
+        while (numConnected.load() < numConns)
+        {
+            usleep(1000);
+        }
+        usleep(100 * 1000);
+        long after = rssKb();
+        printf("connections %d  rss %ld KB -> %ld KB  %.0f bytes/conn\n",
+            numConns, before, after, (after - before) * 1024.0 / numConns);
+
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 负载均衡策略基准测试：连接的存活时间不均匀时，各subloop上的活跃连接数会失衡
+ *   1. 依次建立32个连接，然后关掉下标%4为0、1的那一半(轮询下它们恰好都在loop0和loop1上)
+ *   2. 再建立16个连接，此时32个活跃连接同时做ping-pong，服务端每条消息消耗固定的CPU
+ *   3. 统计请求延迟的p50/p99/p999，以及每个loop最终的连接数
+ * 用法: ./loadbalance_bench [rr|lc|lp|hash] [seconds] [burnUs]
+ */
+
+static const int kThreads = 4;
+static const int kFirstWave = 32;
+static const int kSecondWave = 16;
+static const uint16_t kPort = 9990;
+
+static int burnUs = 20;
+static std::atomic<int> numConnected(0);
+static std::atomic<int> numDisconnected(0);
+
+static void burn(int us)
+{
+    int64_t end = Timestamp::now().microSecondsSinceEpoch() + us;
+    while (Timestamp::now().microSecondsSinceEpoch() < end)
+    {
+    }
+}
+
+static int connectServer()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+// 等服务端处理完，保证连接按顺序分配
+static void waitFor(std::atomic<int>& counter, int expected)
+{
+    while (counter.load() < expected)
+    {
+        usleep(100);
+    }
+}
+
+static void pingPong(int fd, double seconds, std::vector<int64_t>* latencies)
+{
+    char buf[64] = "ping";
+    Timestamp deadline = addTime(Timestamp::now(), seconds);
+    while (Timestamp::now() < deadline)
+    {
+        Timestamp start = Timestamp::now();
+        if (::write(fd, buf, 16) != 16 || ::read(fd, buf, sizeof buf) <= 0)
+        {
+            break;
+        }
+        latencies->push_back(Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* policyName = argc > 1 ? argv[1] : "rr";
+    double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+    burnUs = argc > 3 ? atoi(argv[3]) : 20;
+
+    LoadBalancer::Policy policy = LoadBalancer::kRoundRobin;
+    if (strcmp(policyName, "lc") == 0) policy = LoadBalancer::kLeastConnections;
+    else if (strcmp(policyName, "lp") == 0) policy = LoadBalancer::kLeastPending;
+    else if (strcmp(policyName, "hash") == 0) policy = LoadBalancer::kConsistentHash;
+
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "LoadBalanceBench");
+    std::mutex mutex;
+    std::vector<EventLoop*> loops;
+    server.setThreadNum(kThreads);
+    server.setLoadBalancePolicy(policy);
+    server.setThreadInitCallback([&](EventLoop* ioLoop) {
+        std::lock_guard<std::mutex> lock(mutex);
+        loops.push_back(ioLoop);
+    });
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            ++numConnected;
+        }
+        else
+        {
+            ++numDisconnected;
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        burn(burnUs);
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+
+    std::thread client([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < kFirstWave; ++i)
+        {
+            fds.push_back(connectServer());
+            waitFor(numConnected, i + 1);
+        }
+
+        std::vector<int> active;
+        int closed = 0;
+        for (int i = 0; i < kFirstWave; ++i)
+        {
+            if (i % 4 < 2)
+            {
+                ::close(fds[i]);
+                ++closed;
+            }
+            else
+            {
+                active.push_back(fds[i]);
+            }
+        }
+        waitFor(numDisconnected, closed);
+
+        for (int i = 0; i < kSecondWave; ++i)
+        {
+            active.push_back(connectServer());
+            waitFor(numConnected, kFirstWave + i + 1);
+        }
+
+        std::vector<std::vector<int64_t>> latencies(active.size());
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < active.size(); ++i)
+        {
+            workers.emplace_back(pingPong, active[i], seconds, &latencies[i]);
+        }
+        for (std::thread& t : workers)
+        {
+            t.join();
+        }
+
+        std::vector<int64_t> all;
+        for (auto& v : latencies)
+        {
+            all.insert(all.end(), v.begin(), v.end());
+        }
+        std::sort(all.begin(), all.end());
+        if (!all.empty())
+        {
+            printf("policy %-4s requests %8zu  p50 %6ld us  p99 %6ld us  p999 %6ld us\n",
+                policyName, all.size(),
+                (long)all[all.size() / 2],
+                (long)all[all.size() * 99 / 100],
+                (long)all[all.size() * 999 / 1000]);
+        }
+        printf("connections per loop:");
+        for (EventLoop* ioLoop : loops)
+        {
+            printf(" %d", ioLoop->numConnections());
+        }
+        printf("\n");
+
+        for (int fd : active)
+        {
+            ::close(fd);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Poller后端基准测试：N个连接同时做ping-pong echo
+ * 统计每秒请求数，以及服务端每个请求平均的poller系统调用次数(epoll_wait/epoll_ctl或io_uring_enter)
+ * 和subloop线程的read/write类系统调用次数(/proc/self/task/<tid>/io的syscr/syscw)
+ * 后端在创建EventLoop之前通过环境变量MUDUO_USE_URING选择，completion是io_uring加完成模式收发(TcpServer::setCompletionIo)
+ * 用法: ./poller_bench [epoll|uring|completion] [connections] [seconds] [threads]
+ */
+
+static const uint16_t kPort = 9991;
+
+static std::atomic<int> numConnected(0);
+
+// 线程tid累计的read类/write类系统调用次数
+static uint64_t ioSyscalls(pid_t tid)
+{
+    char path[64];
+    snprintf(path, sizeof path, "/proc/self/task/%d/io", tid);
+    FILE* fp = fopen(path, "r");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    uint64_t total = 0;
+    char key[32];
+    unsigned long long value;
+    while (fscanf(fp, "%31s %llu", key, &value) == 2)
+    {
+        if (strcmp(key, "syscr:") == 0 || strcmp(key, "syscw:") == 0)
+        {
+            total += value;
+        }
+    }
+    fclose(fp);
+    return total;
+}
+
+static int connectServer()
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+static void pingPong(int fd, double seconds, int64_t* requests)
+{
+    char buf[64] = "ping";
+    Timestamp deadline = addTime(Timestamp::now(), seconds);
+    while (Timestamp::now() < deadline)
+    {
+        if (::write(fd, buf, 16) != 16 || ::read(fd, buf, sizeof buf) <= 0)
+        {
+            break;
+        }
+        ++*requests;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* backend = argc > 1 ? argv[1] : "epoll";
+    int numConns = argc > 2 ? atoi(argv[2]) : 64;
+    double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+    int threads = argc > 4 ? atoi(argv[4]) : 2;
+
+    bool completion = strcmp(backend, "completion") == 0;
+    if (strcmp(backend, "uring") == 0 || completion)
+    {
+        ::setenv("MUDUO_USE_URING", "1", 1);
+    }
+    else
+    {
+        ::unsetenv("MUDUO_USE_URING");
+    }
+    Logger::setLogLevel(ERROR);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "PollerBench");
+    std::mutex mutex;
+    std::vector<EventLoop*> loops;
+    std::vector<pid_t> loopTids;
+    server.setThreadNum(threads);
+    server.setCompletionIo(completion);
+    server.setThreadInitCallback([&](EventLoop* ioLoop) {
+        std::lock_guard<std::mutex> lock(mutex);
+        loops.push_back(ioLoop);
+        loopTids.push_back(static_cast<pid_t>(::syscall(SYS_gettid)));
+    });
+    server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            ++numConnected;
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+
+    std::thread client([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < numConns; ++i)
+        {
+            fds.push_back(connectServer());
+        }
+        while (numConnected.load() < numConns)
+        {
+            usleep(100);
+        }
+
+        auto syscalls = [&]() {
+            uint64_t n = 0;
+            for (EventLoop* ioLoop : loops)
+            {
+                n += ioLoop->numPollerSyscalls();
+            }
+            return n;
+        };
+        auto rwSyscalls = [&]() {
+            uint64_t n = 0;
+            for (pid_t tid : loopTids)
+            {
+                n += ioSyscalls(tid);
+            }
+            return n;
+        };
+        uint64_t syscallsBefore = syscalls();
+        uint64_t rwBefore = rwSyscalls();
+
+        std::vector<int64_t> requests(fds.size(), 0);
+        std::vector<std::thread> workers;
+        Timestamp start = Timestamp::now();
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            workers.emplace_back(pingPong, fds[i], seconds, &requests[i]);
+        }
+        for (std::thread& t : workers)
+        {
+            t.join();
+        }
+        double elapsed = timeDifference(Timestamp::now(), start);
+        uint64_t syscallsAfter = syscalls();
+        uint64_t rwAfter = rwSyscalls();
+
+        int64_t total = 0;
+        for (int64_t n : requests)
+        {
+            total += n;
+        }
+        printf("backend %-10s connections %4d  requests/s %9.0f  poller syscalls/request %.3f  read/write syscalls/request %.3f\n",
+            backend, numConns, total / elapsed,
+            total > 0 ? static_cast<double>(syscallsAfter - syscallsBefore) / total : 0.0,
+            total > 0 ? static_cast<double>(rwAfter - rwBefore) / total : 0.0);
+
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    client.join();
+    return 0;
+}
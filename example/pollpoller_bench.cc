@@ -0,0 +1,118 @@
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Channel.h>
+#include <mymuduo/Timestamp.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <vector>
+#include <memory>
+
+/**
+ * PollPoller和EPollPoller在少量fd时的对比：一个loop上挂n个pipe，一个字节的令牌在pipe之间依次传递
+ *   steady: 所有channel一直关注可读，每一轮只有poll本身的开销
+ *   toggle: 只有持有令牌的channel关注可读，每一轮都要关掉自己、打开下一个(epoll每轮两次epoll_ctl)
+ * 输出每一轮的平均耗时和poller系统调用次数
+ * 用法: ./pollpoller_bench [rounds]
+ */
+
+struct Ring
+{
+    std::vector<int> readFds;
+    std::vector<int> writeFds;
+    std::vector<std::unique_ptr<Channel>> channels;
+    bool toggle = false;
+    size_t rounds = 0;
+    size_t target = 0;
+};
+
+static void onReadable(EventLoop* loop, Ring* ring, size_t i)
+{
+    char c;
+    ::read(ring->readFds[i], &c, 1);
+    if (++ring->rounds == ring->target)
+    {
+        loop->quit();
+        return;
+    }
+    size_t next = (i + 1) % ring->readFds.size();
+    if (ring->toggle && next != i)
+    {
+        ring->channels[i]->disableReading();
+        ring->channels[next]->enableReading();
+    }
+    ::write(ring->writeFds[next], &c, 1);
+}
+
+static void runOnce(const char* backend, size_t numFds, bool toggle, size_t target)
+{
+    if (backend[0] == 'p')
+    {
+        ::setenv("MUDUO_USE_POLL", "1", 1);
+    }
+    else
+    {
+        ::unsetenv("MUDUO_USE_POLL");
+    }
+
+    EventLoop loop;
+    Ring ring;
+    ring.toggle = toggle;
+    ring.target = target;
+    for (size_t i = 0; i < numFds; ++i)
+    {
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+        {
+            perror("pipe2");
+            exit(1);
+        }
+        ring.readFds.push_back(fds[0]);
+        ring.writeFds.push_back(fds[1]);
+        ring.channels.emplace_back(new Channel(&loop, fds[0]));
+        ring.channels[i]->setReadCallback([&loop, &ring, i](Timestamp) { onReadable(&loop, &ring, i); });
+        if (!toggle || i == 0)
+        {
+            ring.channels[i]->enableReading();
+        }
+    }
+
+    ::write(ring.writeFds[0], "x", 1);
+    uint64_t syscallsBefore = loop.numPollerSyscalls();
+    Timestamp start(Timestamp::now());
+    loop.loop();
+    Timestamp end(Timestamp::now());
+    uint64_t syscalls = loop.numPollerSyscalls() - syscallsBefore;
+
+    printf("%-5s %-6s fds %3zu: %7.1f ns/round  %.2f syscalls/round\n",
+        backend, toggle ? "toggle" : "steady", numFds,
+        (end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) * 1000.0 / target,
+        static_cast<double>(syscalls) / target);
+
+    for (size_t i = 0; i < numFds; ++i)
+    {
+        ring.channels[i]->disableAll();
+        ring.channels[i]->remove();
+        ::close(ring.readFds[i]);
+        ::close(ring.writeFds[i]);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t rounds = argc > 1 ? atol(argv[1]) : 200000;
+    Logger::setLogLevel(ERROR);
+
+    const size_t sizes[] = { 1, 4, 16, 64 };
+    for (int toggle = 0; toggle < 2; ++toggle)
+    {
+        for (size_t n : sizes)
+        {
+            runOnce("epoll", n, toggle, rounds);
+            runOnce("poll", n, toggle, rounds);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * 忙轮询对唤醒延迟的影响：主线程每隔intervalUs向subloop投递一个回调(queueInLoop => wakeup)
+ * 读取subloop的唤醒延迟直方图(EventLoop::wakeupLatencyHistogram)，输出p50/p99/p999
+ * 忙轮询需要subloop独占一个CPU核，核数不够时它会和投递线程抢CPU，延迟反而变差
+ * 用法: ./spinpoll_bench [spinUs] [count] [intervalUs]
+ */
+
+// 直方图第i个桶是[2^i, 2^(i+1))纳秒，返回分位点所在桶的上界
+static uint64_t percentileNs(const std::vector<uint64_t>& histogram, double p)
+{
+    uint64_t total = 0;
+    for (uint64_t n : histogram)
+    {
+        total += n;
+    }
+    uint64_t target = static_cast<uint64_t>(total * p);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < histogram.size(); ++i)
+    {
+        seen += histogram[i];
+        if (seen > target)
+        {
+            return 2ULL << i;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    int spinUs = argc > 1 ? atoi(argv[1]) : 0;
+    int count = argc > 2 ? atoi(argv[2]) : 20000;
+    int intervalUs = argc > 3 ? atoi(argv[3]) : 50;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    loop->setSpinPollUs(spinUs);
+
+    std::atomic<int> done(0);
+    for (int i = 0; i < count; ++i)
+    {
+        loop->queueInLoop([&done]() { ++done; });
+        usleep(intervalUs);
+    }
+    while (done.load() < count)
+    {
+        usleep(100);
+    }
+
+    std::vector<uint64_t> histogram = loop->wakeupLatencyHistogram();
+    printf("spin %4d us  wakeups %lu  poller syscalls %lu  p50 <%lu ns  p99 <%lu ns  p999 <%lu ns\n",
+        spinUs, (unsigned long)loop->numWakeups(), (unsigned long)loop->numPollerSyscalls(),
+        (unsigned long)percentileNs(histogram, 0.50),
+        (unsigned long)percentileNs(histogram, 0.99),
+        (unsigned long)percentileNs(histogram, 0.999));
+    for (size_t i = 0; i < histogram.size(); ++i)
+    {
+        if (histogram[i] > 0)
+        {
+            printf("  [%10lu, %10lu) ns  %lu\n", 1UL << i, 2UL << i, (unsigned long)histogram[i]);
+        }
+    }
+    return 0;
+}
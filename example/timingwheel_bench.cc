@@ -0,0 +1,83 @@
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/TimingWheel.h>
+#include <mymuduo/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <memory>
+
+/**
+ * 时间轮基准测试：100万个空闲超时同时挂在一个loop的时间轮上，
+ * 测量 schedule / touch(每次handleRead的重置) / tick 的单次耗时
+ * 用法: ./timingwheel_bench [numEntries] [numTouches]
+ */
+
+static double elapsedNs(Timestamp start, Timestamp end, size_t ops)
+{
+    return (end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) * 1000.0 / ops;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t numEntries = argc > 1 ? atol(argv[1]) : 1000000;
+    size_t numTouches = argc > 2 ? atol(argv[2]) : 10000000;
+
+    EventLoop loop;
+    TimingWheel* wheel = loop.timingWheel();
+    std::unique_ptr<TimingWheel::Entry[]> entries(new TimingWheel::Entry[numEntries]);
+    size_t expired = 0;
+    for (size_t i = 0; i < numEntries; ++i)
+    {
+        entries[i].setCallback([&expired]() { ++expired; });
+    }
+
+    // 随机的访问顺序，模拟大量连接交替收到数据
+    std::vector<uint32_t> order(numTouches);
+    srand(1);
+    for (size_t i = 0; i < numTouches; ++i)
+    {
+        order[i] = static_cast<uint32_t>(rand() % numEntries);
+    }
+
+    Timestamp start(Timestamp::now());
+    for (size_t i = 0; i < numEntries; ++i)
+    {
+        wheel->schedule(&entries[i], 60.0 + static_cast<double>(i % 60));
+    }
+    Timestamp end(Timestamp::now());
+    printf("schedule  %zu entries: %.1f ns/op\n", numEntries, elapsedNs(start, end, numEntries));
+
+    start = Timestamp::now();
+    for (size_t i = 0; i < numTouches; ++i)
+    {
+        entries[order[i]].touch();
+    }
+    end = Timestamp::now();
+    printf("touch     %zu times with %zu armed: %.1f ns/op\n",
+        numTouches, wheel->size(), elapsedNs(start, end, numTouches));
+
+    // 重新调度(unlink + link)，即不使用惰性touch时每次重置的开销
+    start = Timestamp::now();
+    for (size_t i = 0; i < numTouches; ++i)
+    {
+        wheel->schedule(&entries[order[i]], 60.0);
+    }
+    end = Timestamp::now();
+    printf("reschedule %zu times with %zu armed: %.1f ns/op\n",
+        numTouches, wheel->size(), elapsedNs(start, end, numTouches));
+
+    // 手动推进时间轮直到全部到期，统计每个tick的平均耗时(包含被touch过的entry的搬迁)
+    size_t ticks = 0;
+    start = Timestamp::now();
+    while (wheel->size() > 0)
+    {
+        wheel->tick();
+        ++ticks;
+    }
+    end = Timestamp::now();
+    printf("tick      %zu ticks, %zu expired: %.1f us/tick\n",
+        ticks, expired, elapsedNs(start, end, ticks) / 1000.0);
+
+    return 0;
+}